@@ -0,0 +1,319 @@
+/**
+ * Organization Tree Arena
+ *
+ * Bump allocator that carves OrgTree storage out of chunks borrowed from a
+ * shared OrgSlabPool.  The pool is a buddy allocator over large slabs: it
+ * splits a slab into power-of-two chunks (2 KiB up to a whole slab) so many
+ * small trees share one slab, merges freed chunks back with their buddies,
+ * and returns a slab to the system as soon as all of it is free again.  Each
+ * arena starts with the smallest chunk and doubles the size of every chunk it
+ * asks for after that.  Individual allocations are never freed; the arena
+ * hands all of its chunks back to the pool at once when it is released.
+ * Neither class is thread-safe; OrgForest guards each pool with a shard lock.
+ *
+ * Author: Jonathan Zentgraf
+ */
+
+#include "OrgArena.h"
+#include <cstdint>
+#include <new>
+
+/**
+ * Constructs an empty pool that cuts its chunks from slabs of (at least) the
+ * given size.  The slab size is rounded up to a power of two no smaller than
+ * ORGARENA_MIN_CHUNK.
+ *
+ * Precondition:  None.
+ * Postcondition: The pool is initialized with no slabs.
+ * Performance:   Θ(log s), s is the slab size
+ */
+OrgSlabPool::OrgSlabPool(std::size_t slabSize) : slabSize(ORGARENA_MIN_CHUNK)
+{
+	freeChunks.push_back(nullptr);
+	while (this->slabSize < slabSize)
+	{
+		this->slabSize <<= 1;
+		freeChunks.push_back(nullptr);
+	}
+}
+
+/**
+ * Destructs the pool.
+ *
+ * Precondition:  Every arena using this pool has been released.
+ * Postcondition: All of the pool's slabs are freed.
+ * Performance:   Θ(s), s is the number of slabs
+ */
+OrgSlabPool::~OrgSlabPool()
+{
+	for (char *slab : slabs)
+	{
+		::operator delete(slab);
+	}
+	::operator delete(spareSlab);
+}
+
+/**
+ * Returns the size of the shared slabs (and so of the largest pooled chunk).
+ *
+ * Precondition:  None.
+ * Postcondition: None.
+ * Performance:   Θ(1)
+ */
+std::size_t OrgSlabPool::getSlabSize() const
+{
+	return slabSize;
+}
+
+/**
+ * Hands out a chunk with room for at least the given number of bytes.
+ * Chunks are rounded up to a power of two and cut from the smallest free
+ * chunk that is big enough, splitting it in halves until it fits; a new slab
+ * is only started when no free chunk is big enough.  Requests that don't fit
+ * in a slab get a chunk of their own.
+ *
+ * Precondition:  None.
+ * Postcondition: The returned chunk belongs to the caller until it is released.
+ * Performance:   Θ(log s), s is the slab size
+ *
+ * Returns:       The chunk (never nullptr; throws std::bad_alloc on failure).
+ */
+OrgSlab *OrgSlabPool::acquire(std::size_t bytes)
+{
+	std::size_t chunkSize = ORGARENA_MIN_CHUNK;
+	std::size_t sizeClass = 0;
+	while (chunkSize < bytes + sizeof(OrgSlab) && chunkSize < slabSize)
+	{
+		chunkSize <<= 1;
+		sizeClass++;
+	}
+
+	if (chunkSize < bytes + sizeof(OrgSlab))
+	{
+		// too big to share a slab
+		OrgSlab *chunk = static_cast<OrgSlab *>(::operator new(sizeof(OrgSlab) + bytes));
+		chunk->next = nullptr;
+		chunk->size = bytes;
+		chunk->slab = nullptr;
+		chunk->free = false;
+		return chunk;
+	}
+
+	// find the smallest free chunk that's big enough, or start a slab
+	std::size_t freeClass = sizeClass;
+	while (freeClass < freeChunks.size() && freeChunks[freeClass] == nullptr) freeClass++;
+	OrgSlab *chunk;
+	if (freeClass < freeChunks.size())
+	{
+		chunk = freeChunks[freeClass];
+		unlinkFree(chunk, freeClass);
+	}
+	else
+	{
+		freeClass = freeChunks.size() - 1;
+		char *slab = spareSlab;
+		spareSlab = nullptr;
+		if (slab == nullptr) slab = static_cast<char *>(::operator new(slabSize));
+		slabs.push_back(slab);
+		chunk = reinterpret_cast<OrgSlab *>(slab);
+		chunk->slab = slab;
+	}
+
+	// split off upper halves (the buddies) until the chunk is the right size
+	for (; freeClass > sizeClass; freeClass--)
+	{
+		std::size_t half = (std::size_t) ORGARENA_MIN_CHUNK << (freeClass - 1);
+		OrgSlab *buddy = reinterpret_cast<OrgSlab *>(reinterpret_cast<char *>(chunk) + half);
+		buddy->slab = chunk->slab;
+		pushFree(buddy, freeClass - 1);
+	}
+
+	chunk->next = nullptr;
+	chunk->size = chunkSize - sizeof(OrgSlab);
+	chunk->free = false;
+	return chunk;
+}
+
+/**
+ * Takes back a chain of chunks linked through their next pointers.
+ * Each pooled chunk is merged with its buddy for as long as the buddy is free
+ * too; a slab that ends up completely free goes back to the system.
+ * Oversized chunks are freed immediately.
+ *
+ * Precondition:  The chunks were acquired from this pool.
+ * Postcondition: The chunks' memory can be acquired again.
+ * Performance:   Θ(c log s), c is the number of chunks in the chain, s is the slab size
+ */
+void OrgSlabPool::release(OrgSlab *chunks)
+{
+	while (chunks != nullptr)
+	{
+		OrgSlab *next = chunks->next;
+		char *slab = chunks->slab;
+		if (slab == nullptr)
+		{
+			::operator delete(chunks);
+			chunks = next;
+			continue;
+		}
+
+		std::size_t chunkSize = chunks->size + sizeof(OrgSlab);
+		std::size_t sizeClass = 0;
+		while ((std::size_t) ORGARENA_MIN_CHUNK << sizeClass < chunkSize) sizeClass++;
+
+		// a chunk's buddy is the other half of the chunk twice its size
+		std::size_t offset = reinterpret_cast<char *>(chunks) - slab;
+		while (chunkSize < slabSize)
+		{
+			OrgSlab *buddy = reinterpret_cast<OrgSlab *>(slab + (offset ^ chunkSize));
+			// the buddy may have been split; then its header belongs to a smaller chunk
+			if (!buddy->free || buddy->size + sizeof(OrgSlab) != chunkSize) break;
+			unlinkFree(buddy, sizeClass);
+			offset &= ~chunkSize;
+			chunkSize <<= 1;
+			sizeClass++;
+		}
+
+		if (chunkSize == slabSize)
+		{
+			releaseSlab(slab);
+		}
+		else
+		{
+			OrgSlab *merged = reinterpret_cast<OrgSlab *>(slab + offset);
+			merged->slab = slab;
+			pushFree(merged, sizeClass);
+		}
+		chunks = next;
+	}
+}
+
+/**
+ * Puts a chunk on the free list of its size class.
+ *
+ * Precondition:  The chunk's slab is set and the chunk is not on a free list.
+ * Postcondition: The chunk is free.
+ * Performance:   Θ(1)
+ */
+void OrgSlabPool::pushFree(OrgSlab *chunk, std::size_t sizeClass)
+{
+	chunk->size = ((std::size_t) ORGARENA_MIN_CHUNK << sizeClass) - sizeof(OrgSlab);
+	chunk->free = true;
+	chunk->prev = nullptr;
+	chunk->next = freeChunks[sizeClass];
+	if (chunk->next != nullptr) chunk->next->prev = chunk;
+	freeChunks[sizeClass] = chunk;
+}
+
+/**
+ * Takes a chunk off the free list of its size class.
+ *
+ * Precondition:  The chunk is on that free list.
+ * Postcondition: The chunk is no longer free.
+ * Performance:   Θ(1)
+ */
+void OrgSlabPool::unlinkFree(OrgSlab *chunk, std::size_t sizeClass)
+{
+	if (chunk->prev != nullptr) chunk->prev->next = chunk->next;
+	else freeChunks[sizeClass] = chunk->next;
+	if (chunk->next != nullptr) chunk->next->prev = chunk->prev;
+	chunk->free = false;
+}
+
+/**
+ * Gives a completely free slab back, keeping at most one in reserve.
+ *
+ * Precondition:  No part of the slab is in use or on a free list.
+ * Postcondition: The slab is the spare slab or has been freed.
+ * Performance:   Θ(s), s is the number of slabs
+ */
+void OrgSlabPool::releaseSlab(char *slab)
+{
+	for (std::size_t i = 0; i < slabs.size(); i++)
+	{
+		if (slabs[i] == slab)
+		{
+			slabs[i] = slabs.back();
+			slabs.pop_back();
+			break;
+		}
+	}
+
+	if (spareSlab == nullptr)
+	{
+		spareSlab = slab;
+	}
+	else
+	{
+		::operator delete(slab);
+	}
+}
+
+/**
+ * Constructs an arena that borrows its chunks from the given pool.
+ *
+ * Precondition:  The pool outlives the arena.
+ * Postcondition: The arena is initialized without any chunks.
+ * Performance:   Θ(1)
+ */
+OrgArena::OrgArena(OrgSlabPool *pool) : pool(pool)
+{
+}
+
+/**
+ * Destructs the arena, returning its chunks to the pool.
+ *
+ * Precondition:  Nothing allocated from the arena is still in use.
+ * Postcondition: The arena's chunks are back in the pool.
+ * Performance:   Θ(c), c is the number of chunks held by the arena
+ */
+OrgArena::~OrgArena()
+{
+	release();
+}
+
+/**
+ * Allocates uninitialized memory from the current chunk, starting a new
+ * (twice as large) chunk when the current one is full.
+ *
+ * Precondition:  alignment is a power of two no larger than alignof(std::max_align_t).
+ * Postcondition: The memory stays valid until the arena is released.
+ * Performance:   Θ(1) amortized
+ *
+ * Returns:       A pointer to at least bytes bytes of suitably aligned memory.
+ */
+void *OrgArena::allocate(std::size_t bytes, std::size_t alignment)
+{
+	std::uintptr_t address = (reinterpret_cast<std::uintptr_t>(cursor) + alignment - 1) & ~(alignment - 1);
+	if (cursor == nullptr || address + bytes > reinterpret_cast<std::uintptr_t>(limit))
+	{
+		// the old chunk's leftover space is abandoned until the arena is released
+		std::size_t request = nextChunkSize - sizeof(OrgSlab);
+		OrgSlab *chunk = pool->acquire((bytes > request) ? bytes : request);
+		if (nextChunkSize < pool->getSlabSize()) nextChunkSize <<= 1;
+		chunk->next = chunks;
+		chunks = chunk;
+		cursor = reinterpret_cast<char *>(chunk + 1);
+		limit = cursor + chunk->size;
+		address = reinterpret_cast<std::uintptr_t>(cursor);
+	}
+
+	cursor = reinterpret_cast<char *>(address + bytes);
+	return reinterpret_cast<void *>(address);
+}
+
+/**
+ * Returns every chunk to the pool at once.
+ *
+ * Precondition:  Nothing allocated from the arena is still in use.
+ * Postcondition: The arena is empty and can be allocated from again.
+ * Performance:   Θ(c log s), c is the number of chunks held by the arena, s is the slab size
+ */
+void OrgArena::release()
+{
+	pool->release(chunks);
+	chunks = nullptr;
+	cursor = nullptr;
+	limit = nullptr;
+	nextChunkSize = ORGARENA_MIN_CHUNK;
+}
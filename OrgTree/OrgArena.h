@@ -0,0 +1,92 @@
+/**
+ * Organization Tree Arena
+ *
+ * Bump allocator that carves OrgTree storage out of chunks borrowed from a
+ * shared OrgSlabPool.  The pool is a buddy allocator over large slabs: it
+ * splits a slab into power-of-two chunks (2 KiB up to a whole slab) so many
+ * small trees share one slab, merges freed chunks back with their buddies,
+ * and returns a slab to the system as soon as all of it is free again.  Each
+ * arena starts with the smallest chunk and doubles the size of every chunk it
+ * asks for after that.  Individual allocations are never freed; the arena
+ * hands all of its chunks back to the pool at once when it is released.
+ * Neither class is thread-safe; OrgForest guards each pool with a shard lock.
+ *
+ * Author: Jonathan Zentgraf
+ */
+
+#ifndef ORGARENA_H
+#define ORGARENA_H
+
+#include <cstddef>
+#include <vector>
+
+#define ORGARENA_DEFAULT_SLAB_SIZE (64 * 1024)
+// an empty OrgTree with the default capacity needs a little over 1 KiB
+#define ORGARENA_MIN_CHUNK (2 * 1024)
+
+struct OrgSlab
+{
+	OrgSlab *next;
+	std::size_t size;  // usable bytes following this header
+	// only used by the pool
+	OrgSlab *prev;     // free list link
+	char *slab;        // the slab this chunk was cut from, nullptr if it has an allocation of its own
+	bool free;
+};
+
+class OrgSlabPool
+{
+private:
+	std::size_t slabSize;
+	// free chunks of each size class (ORGARENA_MIN_CHUNK << i bytes, header included)
+	std::vector<OrgSlab *> freeChunks;
+	std::vector<char *> slabs;
+	// one completely free slab is kept back so a tenant coming and going doesn't thrash the heap
+	char *spareSlab = nullptr;
+
+	void pushFree(OrgSlab *chunk, std::size_t sizeClass);
+
+	void unlinkFree(OrgSlab *chunk, std::size_t sizeClass);
+
+	void releaseSlab(char *slab);
+
+public:
+	explicit OrgSlabPool(std::size_t slabSize = ORGARENA_DEFAULT_SLAB_SIZE);
+
+	~OrgSlabPool();
+
+	OrgSlabPool(const OrgSlabPool&) = delete;
+
+	OrgSlabPool& operator=(const OrgSlabPool&) = delete;
+
+	std::size_t getSlabSize() const;
+
+	OrgSlab *acquire(std::size_t bytes);
+
+	void release(OrgSlab *chunks);
+};
+
+class OrgArena
+{
+private:
+	OrgSlabPool *pool;
+	OrgSlab *chunks = nullptr;
+	char *cursor = nullptr;
+	char *limit = nullptr;
+	std::size_t nextChunkSize = ORGARENA_MIN_CHUNK;
+
+public:
+	explicit OrgArena(OrgSlabPool *pool);
+
+	~OrgArena();
+
+	OrgArena(const OrgArena&) = delete;
+
+	OrgArena& operator=(const OrgArena&) = delete;
+
+	void *allocate(std::size_t bytes, std::size_t alignment);
+
+	void release();
+};
+
+#endif //ORGARENA_H
@@ -0,0 +1,264 @@
+/**
+ * Organization Forest
+ *
+ * Hosts many independent OrgTrees (one per tenant) in a single process.
+ * Tenants are spread over shards by a hash of their id; each shard has its own
+ * lock and its own pool of slabs, so tenants on different shards never contend.
+ * Every tenant's tree lives entirely in its own arena, whose chunks are cut from
+ * the shard's shared slabs, and evicting the tenant hands all of the arena's
+ * chunks back to the shard at once.
+ *
+ * Author: Jonathan Zentgraf
+ */
+
+#include "OrgForest.h"
+#include <functional>
+#include <iostream>
+#include <new>
+
+/**
+ * Constructs an empty forest with the given number of shards.  Each shard
+ * allocates memory from the system in slabs of slabSize bytes; a shard's
+ * tenants share its slabs, so the default (64 KiB) only costs a few slabs per
+ * shard while keeping slab allocations rare for large trees.
+ *
+ * Precondition:  shardCount > 0.
+ * Postcondition: The forest is initialized without any tenants.
+ * Performance:   Θ(s), s is the number of shards
+ */
+OrgForest::OrgForest(unsigned int shardCount, std::size_t slabSize) : shardCount(shardCount)
+{
+	// Shard holds a mutex, so the shards are built in place one at a time
+	shards = static_cast<Shard *>(::operator new(shardCount * sizeof(Shard)));
+	for (unsigned int i = 0; i < shardCount; i++)
+	{
+		new (&shards[i]) Shard(slabSize);
+	}
+}
+
+/**
+ * Destructs the forest.
+ *
+ * Precondition:  No Access objects are still alive.
+ * Postcondition: Every tenant is destroyed and all slabs are freed.
+ * Performance:   Θ(n), n is the total number of nodes in all trees
+ */
+OrgForest::~OrgForest()
+{
+	for (unsigned int i = 0; i < shardCount; i++)
+	{
+		for (Tenant *tenant : shards[i].tenants)
+		{
+			if (tenant->tree != nullptr) tenant->tree->~OrgTree();
+			// the tenant's arena gives its chunks back to the pool as it is destroyed
+			delete tenant;
+		}
+		shards[i].~Shard();
+	}
+	::operator delete(shards);
+}
+
+/**
+ * Adds a new tenant with an empty tree, or finds the tenant if it already exists.
+ *
+ * Precondition:  None.
+ * Postcondition: The tenant exists in the forest.
+ * Performance:   Θ(1) expected
+ *
+ * Returns:       A handle to the tenant.
+ */
+OrgForest::Handle OrgForest::addTenant(const std::string& id)
+{
+	unsigned int shardIndex = shardOf(id);
+	Shard& shard = shards[shardIndex];
+	std::lock_guard<std::mutex> guard(shard.lock);
+
+	auto existing = shard.slotsById.find(id);
+	if (existing != shard.slotsById.end())
+	{
+		return Handle{shardIndex, existing->second, shard.tenants[existing->second]->generation};
+	}
+
+	// reuse an evicted tenant's slot if we can
+	unsigned int slot;
+	if (!shard.freeSlots.empty())
+	{
+		slot = shard.freeSlots.back();
+		shard.freeSlots.pop_back();
+	}
+	else
+	{
+		slot = (unsigned int) shard.tenants.size();
+		shard.tenants.push_back(new Tenant(&shard.pool));
+	}
+
+	// the tree object itself lives in the arena next to its nodes
+	Tenant *tenant = shard.tenants[slot];
+	tenant->id = id;
+	void *memory = tenant->arena.allocate(sizeof(OrgTree), alignof(OrgTree));
+	tenant->tree = new (memory) OrgTree(&tenant->arena);
+	shard.slotsById[id] = slot;
+
+	return Handle{shardIndex, slot, tenant->generation};
+}
+
+/**
+ * Looks up a tenant by id.
+ *
+ * Precondition:  None.
+ * Postcondition: handle refers to the tenant if it was found; otherwise it is unchanged.
+ * Performance:   Θ(1) expected
+ *
+ * Returns:       true if the tenant exists; false otherwise.
+ */
+bool OrgForest::findTenant(const std::string& id, Handle& handle)
+{
+	unsigned int shardIndex = shardOf(id);
+	Shard& shard = shards[shardIndex];
+	std::lock_guard<std::mutex> guard(shard.lock);
+
+	auto existing = shard.slotsById.find(id);
+	if (existing == shard.slotsById.end()) return false;
+
+	handle = Handle{shardIndex, existing->second, shard.tenants[existing->second]->generation};
+	return true;
+}
+
+/**
+ * Locks a tenant's shard and gives access to the tenant's tree.
+ *
+ * Precondition:  The calling thread holds no other Access (tenants that hash
+ *                to the same shard share its lock, which would deadlock).
+ * Postcondition: The shard stays locked until the returned Access is destroyed.
+ * Performance:   Θ(1) (plus waiting for the shard lock)
+ *
+ * Returns:       Access to the tree; it tests false if the handle is stale.
+ */
+OrgForest::Access OrgForest::access(Handle handle)
+{
+	if (handle.shard >= shardCount)
+	{
+		std::cerr << "(access) Shard " << handle.shard << " does not exist." << std::endl;
+		return Access(std::unique_lock<std::mutex>(), nullptr);
+	}
+
+	Shard& shard = shards[handle.shard];
+	std::unique_lock<std::mutex> lock(shard.lock);
+	if (!isLive(shard, handle))
+	{
+		std::cerr << "(access) Tenant handle is stale." << std::endl;
+		return Access(std::unique_lock<std::mutex>(), nullptr);
+	}
+
+	OrgTree *tree = shard.tenants[handle.slot]->tree;
+	return Access(std::move(lock), tree);
+}
+
+/**
+ * Locks the shards of two tenants and gives access to both trees.  Tenants on
+ * the same shard share one lock, which is taken once and held by the first
+ * Access; different shards are locked together with std::lock so two threads
+ * asking for the same pair in opposite orders can't deadlock.
+ *
+ * Precondition:  The calling thread holds no other Access, and the two
+ *                returned Accesses are destroyed together (the second one
+ *                may be relying on the first one's lock).
+ * Postcondition: The shards stay locked until the returned Accesses are destroyed.
+ * Performance:   Θ(1) (plus waiting for the shard locks)
+ *
+ * Returns:       Access to both trees; both test false if either handle is stale.
+ */
+std::pair<OrgForest::Access, OrgForest::Access> OrgForest::access(Handle first, Handle second)
+{
+	std::pair<Access, Access> none(Access(std::unique_lock<std::mutex>(), nullptr),
+	                               Access(std::unique_lock<std::mutex>(), nullptr));
+	if (first.shard >= shardCount || second.shard >= shardCount)
+	{
+		std::cerr << "(access) Shard " << ((first.shard >= shardCount) ? first.shard : second.shard)
+		          << " does not exist." << std::endl;
+		return none;
+	}
+
+	Shard& firstShard = shards[first.shard];
+	Shard& secondShard = shards[second.shard];
+	std::unique_lock<std::mutex> firstLock(firstShard.lock, std::defer_lock);
+	std::unique_lock<std::mutex> secondLock;
+	if (&firstShard == &secondShard)
+	{
+		firstLock.lock();
+	}
+	else
+	{
+		secondLock = std::unique_lock<std::mutex>(secondShard.lock, std::defer_lock);
+		std::lock(firstLock, secondLock);
+	}
+
+	if (!isLive(firstShard, first) || !isLive(secondShard, second))
+	{
+		std::cerr << "(access) Tenant handle is stale." << std::endl;
+		return none;
+	}
+
+	return std::pair<Access, Access>(Access(std::move(firstLock), firstShard.tenants[first.slot]->tree),
+	                                 Access(std::move(secondLock), secondShard.tenants[second.slot]->tree));
+}
+
+/**
+ * Removes a tenant, returning all of its tree's chunks to its shard at once.
+ *
+ * Precondition:  No Access to this tenant is alive on the calling thread.
+ * Postcondition: The tenant is gone and every handle to it is stale.
+ * Performance:   Θ(n), n is the number of nodes in the tenant's tree
+ *
+ * Returns:       true if the tenant was evicted, false if the handle was stale.
+ */
+bool OrgForest::evict(Handle handle)
+{
+	if (handle.shard >= shardCount) return false;
+
+	Shard& shard = shards[handle.shard];
+	std::lock_guard<std::mutex> guard(shard.lock);
+	if (!isLive(shard, handle)) return false;
+
+	Tenant *tenant = shard.tenants[handle.slot];
+	// the destructor only has to run the strings' destructors; the arena owns the memory
+	tenant->tree->~OrgTree();
+	tenant->tree = nullptr;
+	tenant->arena.release();
+	tenant->generation++;
+
+	shard.slotsById.erase(tenant->id);
+	tenant->id.clear();
+	shard.freeSlots.push_back(handle.slot);
+	return true;
+}
+
+/**
+ * Chooses the shard for a tenant id.
+ *
+ * Precondition:  None.
+ * Postcondition: None.
+ * Performance:   Θ(k), k is the length of the id
+ *
+ * Returns:       The index of the tenant's shard.
+ */
+unsigned int OrgForest::shardOf(const std::string& id) const
+{
+	return (unsigned int) (std::hash<std::string>()(id) % shardCount);
+}
+
+/**
+ * Checks whether a handle still refers to a live tenant.
+ *
+ * Precondition:  The shard lock is held.
+ * Postcondition: None.
+ * Performance:   Θ(1)
+ *
+ * Returns:       true if the handle is current; false if it is stale.
+ */
+bool OrgForest::isLive(const Shard& shard, Handle handle) const
+{
+	return handle.slot < shard.tenants.size()
+	       && shard.tenants[handle.slot]->tree != nullptr
+	       && shard.tenants[handle.slot]->generation == handle.generation;
+}
@@ -0,0 +1,117 @@
+/**
+ * Organization Forest
+ *
+ * Hosts many independent OrgTrees (one per tenant) in a single process.
+ * Tenants are spread over shards by a hash of their id; each shard has its own
+ * lock and its own pool of slabs, so tenants on different shards never contend.
+ * Every tenant's tree lives entirely in its own arena, whose chunks are cut from
+ * the shard's shared slabs, and evicting the tenant hands all of the arena's
+ * chunks back to the shard at once.
+ *
+ * Author: Jonathan Zentgraf
+ */
+
+#ifndef ORGFOREST_H
+#define ORGFOREST_H
+
+#include "OrgArena.h"
+#include "OrgTree.h"
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#define ORGFOREST_DEFAULT_SHARDS 16
+
+class OrgForest
+{
+public:
+	/**
+	 * Identifies a tenant.  Handles go stale when their tenant is evicted,
+	 * even if the slot is later reused by another tenant.
+	 */
+	struct Handle
+	{
+		unsigned int shard;
+		unsigned int slot;
+		unsigned int generation;
+	};
+
+	/**
+	 * Exclusive access to one tenant's tree.  Holds the tenant's shard lock
+	 * (not a per-tenant lock) for as long as it lives, so every other tenant
+	 * on that shard is locked out too.  The lock isn't recursive: a thread
+	 * that already holds an Access deadlocks if it asks for another tenant
+	 * on the same shard.  To work on two tenants at once (diff and apply
+	 * between them, say) use access(first, second), which takes the locks
+	 * it needs exactly once and in a deadlock-free order.
+	 */
+	class Access
+	{
+	private:
+		std::unique_lock<std::mutex> lock;
+		OrgTree *tree;
+
+	public:
+		Access(std::unique_lock<std::mutex>&& lock, OrgTree *tree) : lock(std::move(lock)), tree(tree) {}
+
+		explicit operator bool() const { return tree != nullptr; }
+
+		OrgTree& operator*() const { return *tree; }
+
+		OrgTree *operator->() const { return tree; }
+	};
+
+private:
+	struct Tenant
+	{
+		std::string id;
+		OrgArena arena;
+		OrgTree *tree = nullptr;  // lives inside arena
+		unsigned int generation = 0;
+
+		explicit Tenant(OrgSlabPool *pool) : arena(pool) {}
+	};
+
+	struct Shard
+	{
+		std::mutex lock;
+		OrgSlabPool pool;
+		// Tenants are never moved, since their trees point at their arenas
+		std::vector<Tenant *> tenants;
+		std::vector<unsigned int> freeSlots;
+		std::unordered_map<std::string, unsigned int> slotsById;
+
+		explicit Shard(std::size_t slabSize) : pool(slabSize) {}
+	};
+
+	unsigned int shardCount;
+	Shard *shards;
+
+	unsigned int shardOf(const std::string& id) const;
+
+	bool isLive(const Shard& shard, Handle handle) const;
+
+public:
+	explicit OrgForest(unsigned int shardCount = ORGFOREST_DEFAULT_SHARDS,
+	                   std::size_t slabSize = ORGARENA_DEFAULT_SLAB_SIZE);
+
+	~OrgForest();
+
+	OrgForest(const OrgForest&) = delete;
+
+	OrgForest& operator=(const OrgForest&) = delete;
+
+	Handle addTenant(const std::string& id);
+
+	bool findTenant(const std::string& id, Handle& handle);
+
+	Access access(Handle handle);
+
+	std::pair<Access, Access> access(Handle first, Handle second);
+
+	bool evict(Handle handle);
+};
+
+#endif //ORGFOREST_H
@@ -0,0 +1,128 @@
+/**
+ * Organization Tree Patch
+ *
+ * An edit script that turns one OrgTree into another.  Edits refer to nodes
+ * by title, so a patch can be computed against one tree and applied to any
+ * other tree with the same titles.  Sibling order is not part of a patch.
+ *
+ * Author: Jonathan Zentgraf
+ */
+
+#include "OrgPatch.h"
+#include "OrgTree.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * Finds the nearest node at or above the given one in from that is also in to,
+ * remembering the answer for every node on the way up so each node is only
+ * walked past once per diff.
+ *
+ * Precondition:  survivors and resolved have one entry per node of from.
+ * Postcondition: The answer is recorded for node and everything walked past.
+ * Performance:   Θ(1) amortized
+ *
+ * Returns:       The surviving node, or TREENULLPTR if nobody above survives.
+ */
+static TREENODEPTR _survivor(const OrgTree& from, const std::unordered_set<std::string>& toTitles, TREENODEPTR node,
+                             std::vector<TREENODEPTR>& survivors, std::vector<char>& resolved)
+{
+	std::vector<TREENODEPTR> path;
+	TREENODEPTR current = node;
+	while (current != TREENULLPTR && !resolved[current])
+	{
+		if (toTitles.count(from.title(current)) != 0)
+		{
+			survivors[current] = current;
+			resolved[current] = 1;
+			break;
+		}
+		path.push_back(current);
+		current = from.parent(current);
+	}
+
+	TREENODEPTR survivor = (current == TREENULLPTR) ? TREENULLPTR : survivors[current];
+	for (TREENODEPTR walked : path)
+	{
+		survivors[walked] = survivor;
+		resolved[walked] = 1;
+	}
+	return survivor;
+}
+
+/**
+ * Computes the edits that turn one tree into another, matching nodes by title.
+ * Hires and moves are emitted top-down (in preorder of the target tree) so every
+ * supervisor is already in place when it is referenced, and fires come last.
+ * Firing a supervisor hands their reports to the nearest supervisor above who
+ * stays, so reports who end up there anyway get no move of their own.
+ *
+ * Precondition:  Titles are unique within each tree, and to is not empty.
+ * Postcondition: None.
+ * Performance:   Θ(n + m) expected, n and m are the number of nodes in each tree
+ *
+ * Returns:       The patch; applying it to from yields to (up to sibling order).
+ */
+OrgPatch diff(const OrgTree& from, const OrgTree& to)
+{
+	OrgPatch patch;
+
+	std::unordered_map<std::string, TREENODEPTR> fromIndices;
+	fromIndices.reserve(from.getSize());
+	for (TREENODEPTR i = 0; i < from.getSize(); i++)
+	{
+		fromIndices[from.title(i)] = i;
+	}
+
+	std::unordered_set<std::string> toTitles;
+	toTitles.reserve(to.getSize());
+	for (TREENODEPTR i = 0; i < to.getSize(); i++)
+	{
+		toTitles.insert(to.title(i));
+	}
+
+	// where each node's reports end up once the fires are done (filled in lazily)
+	std::vector<TREENODEPTR> survivors(from.getSize(), TREENULLPTR);
+	std::vector<char> resolved(from.getSize(), 0);
+
+	for (TREENODEPTR node : to.depthFirst(to.getRoot()))
+	{
+		std::string title = to.title(node);
+		std::string name = to.name(node);
+		TREENODEPTR supervisor = to.parent(node);
+		std::string supervisorTitle = (supervisor == TREENULLPTR) ? "" : to.title(supervisor);
+
+		auto match = fromIndices.find(title);
+		if (match == fromIndices.end())
+		{
+			patch.push_back(OrgEdit{OrgEdit::HIRE, title, name, supervisorTitle});
+			continue;
+		}
+
+		// fires hand reports up to the nearest supervisor who stays, so that's where this node lands without a move
+		TREENODEPTR oldSupervisor = from.parent(match->second);
+		TREENODEPTR survivor = _survivor(from, toTitles, oldSupervisor, survivors, resolved);
+		if (survivor != TREENULLPTR) oldSupervisor = survivor;
+		std::string oldSupervisorTitle = (oldSupervisor == TREENULLPTR) ? "" : from.title(oldSupervisor);
+		if (oldSupervisorTitle != supervisorTitle)
+		{
+			patch.push_back(OrgEdit{OrgEdit::MOVE, title, "", supervisorTitle});
+		}
+		if (from.name(match->second) != name)
+		{
+			patch.push_back(OrgEdit{OrgEdit::RENAME, title, name, ""});
+		}
+	}
+
+	for (TREENODEPTR i = 0; i < from.getSize(); i++)
+	{
+		std::string title = from.title(i);
+		if (toTitles.count(title) == 0)
+		{
+			patch.push_back(OrgEdit{OrgEdit::FIRE, title, "", ""});
+		}
+	}
+
+	return patch;
+}
@@ -0,0 +1,39 @@
+/**
+ * Organization Tree Patch
+ *
+ * An edit script that turns one OrgTree into another.  Edits refer to nodes
+ * by title, so a patch can be computed against one tree and applied to any
+ * other tree with the same titles.  Sibling order is not part of a patch.
+ *
+ * Author: Jonathan Zentgraf
+ */
+
+#ifndef ORGPATCH_H
+#define ORGPATCH_H
+
+#include <string>
+#include <vector>
+
+class OrgTree;
+
+struct OrgEdit
+{
+	enum Kind
+	{
+		HIRE,   // add title/name under supervisor (an empty supervisor means a new root)
+		FIRE,   // remove title; its reports move up to its supervisor
+		MOVE,   // title (and its subtree) now reports to supervisor (empty means it becomes the root)
+		RENAME  // title is now held by name
+	};
+
+	Kind kind;
+	std::string title;
+	std::string name;
+	std::string supervisor;
+};
+
+typedef std::vector<OrgEdit> OrgPatch;
+
+OrgPatch diff(const OrgTree& from, const OrgTree& to);
+
+#endif //ORGPATCH_H
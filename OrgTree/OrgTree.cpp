@@ -2,15 +2,19 @@
  * Organization Tree
  *
  * Stores a set of nodes representing employees in an organization.
- * Space overhead: 3n+4 words for a full array
- *                 (~16% overhead assuming 16 words of data per node)
+ * Space overhead: 6n+10 words for a full array
+ *                 (~27% overhead assuming 16 words of data per node)
  *
  * Author: Jonathan Zentgraf
  */
 
 #include "OrgTree.h"
+#include "OrgArena.h"
 #include <iostream>
 #include <fstream>
+#include <new>
+#include <unordered_map>
+#include <utility>
 
 #define ORGTREE_DEFAULT_CAPACITY 10
 
@@ -21,9 +25,25 @@
  * Postcondition: The OrgTree is initialized with an empty array.
  * Performance:   Θ(1)
  */
-OrgTree::OrgTree()
+OrgTree::OrgTree() : OrgTree(nullptr)
 {
-	tree = new TreeNode[ORGTREE_DEFAULT_CAPACITY];
+}
+
+/**
+ * Constructs the OrgTree with the default capacity, allocating all of its
+ * storage from an arena.
+ *
+ * Precondition:  The arena outlives the OrgTree (or is nullptr to use the heap).
+ * Postcondition: The OrgTree is initialized with an empty array.
+ * Performance:   Θ(1)
+ */
+OrgTree::OrgTree(OrgArena *arena) : arena(arena)
+{
+	tree = allocateArray<TreeNode>(ORGTREE_DEFAULT_CAPACITY);
+	levelOrder = allocateArray<TREENODEPTR>(ORGTREE_DEFAULT_CAPACITY);
+	// there can never be more levels than nodes
+	levelStart = allocateArray<unsigned int>(ORGTREE_DEFAULT_CAPACITY + 1);
+	levelStart[0] = 0;
 	capacity = ORGTREE_DEFAULT_CAPACITY;
 }
 
@@ -36,7 +56,9 @@ OrgTree::OrgTree()
  */
 OrgTree::~OrgTree()
 {
-	delete[] tree;
+	freeArray(tree, capacity);
+	freeArray(levelOrder, capacity);
+	freeArray(levelStart, capacity + 1);
 }
 
 /**
@@ -45,7 +67,7 @@ OrgTree::~OrgTree()
  *
  * Precondition:  None.
  * Postcondition: The tree is assigned a new root node.
- * Performance:   Θ(1)
+ * Performance:   Θ(h), h is the height of the tree
  *
  * Returns:       The index of the new root node of the tree.
  */
@@ -53,13 +75,27 @@ TREENODEPTR OrgTree::addRoot(std::string title, std::string name)
 {
 	ensureCapacity();
 	// use size as the index for the new node (last spot in array)
-	tree[size] = TreeNode{title, name, TREENULLPTR, TREENULLPTR, TREENULLPTR};
+	tree[size] = TreeNode{title, name, TREENULLPTR, TREENULLPTR, TREENULLPTR, 0};
 	// if we previously had a different root, fix parent and child pointers
 	if (root != TREENULLPTR)
 	{
 		tree[size].leftmostChild = root;
 		tree[root].parent = size;
+
+		// everyone moves down a level; shifting the base level does that without visiting them
+		tree[size].level = --rootLevel;
+		// open up an empty level 0 at the front of the level index
+		for (unsigned int i = levelCount + 1; i > 0; i--)
+		{
+			levelStart[i] = levelStart[i - 1];
+		}
+		levelCount++;
 	}
+	else
+	{
+		rootLevel = 0;
+	}
+	levelInsert(size, 0);
 	// acknowledge the new root
 	root = size;
 	return size++;
@@ -193,6 +229,113 @@ std::string OrgTree::name(TREENODEPTR node) const
 	return tree[node].name;
 }
 
+/**
+ * Returns the depth of a node (the root is at depth 0).
+ *
+ * Precondition:  None.
+ * Postcondition: None.
+ * Performance:   Θ(1)
+ *
+ * Returns:       The number of edges between node and the root,
+ *                or -1 if the node does not exist.
+ */
+int OrgTree::depth(TREENODEPTR node) const
+{
+	if (node >= size)
+	{
+		std::cerr << "(depth) Node " << node << " does not exist." << std::endl;
+		return -1;
+	}
+	return tree[node].level - rootLevel;
+}
+
+/**
+ * Returns the number of levels in the tree.
+ *
+ * Precondition:  None.
+ * Postcondition: None.
+ * Performance:   Θ(1)
+ *
+ * Returns:       The number of distinct depths in the tree (0 for an empty tree).
+ */
+unsigned int OrgTree::getHeight() const
+{
+	return levelCount;
+}
+
+/**
+ * Returns all of the nodes at a given depth.
+ * The order of the nodes within a level is unspecified.
+ *
+ * Precondition:  None.
+ * Postcondition: None.
+ * Performance:   Θ(1) (iterating the result is Θ(k), k is the number of nodes at that depth)
+ *
+ * Returns:       The range of node indices at the given depth,
+ *                or an empty range if the tree is not that deep.
+ */
+OrgTree::NodeRange OrgTree::level(unsigned int depth) const
+{
+	if (depth >= levelCount) return NodeRange(levelOrder, levelOrder);
+	return NodeRange(levelOrder + levelStart[depth], levelOrder + levelStart[depth + 1]);
+}
+
+/**
+ * Returns every node in the tree in breadth-first order.
+ * Nodes are grouped by depth; the order within a level is unspecified.
+ *
+ * Precondition:  None.
+ * Postcondition: None.
+ * Performance:   Θ(1) (iterating the result is Θ(n), n is the total number of nodes in the tree)
+ *
+ * Returns:       The range of all node indices, shallowest first.
+ */
+OrgTree::NodeRange OrgTree::breadthFirst() const
+{
+	return NodeRange(levelOrder, levelOrder + size);
+}
+
+/**
+ * Returns the nodes of a subtree in preorder (the same order print uses).
+ *
+ * Precondition:  None.
+ * Postcondition: None.
+ * Performance:   Θ(1) (iterating the result is Θ(n), n is the total number of nodes in the subtree)
+ *
+ * Returns:       A range over the subtree's node indices,
+ *                or an empty range if the node does not exist.
+ */
+OrgTree::DepthFirstRange OrgTree::depthFirst(TREENODEPTR subTreeRoot) const
+{
+	if (subTreeRoot >= size) return DepthFirstRange(DepthFirstIterator(nullptr, TREENULLPTR, TREENULLPTR));
+	return DepthFirstRange(DepthFirstIterator(tree, subTreeRoot, subTreeRoot));
+}
+
+/**
+ * Advances to the next node of the subtree in preorder.
+ *
+ * Precondition:  The iterator is not at the end of its subtree.
+ * Postcondition: The iterator points at the next node, or TREENULLPTR at the end.
+ * Performance:   Best: Θ(1)
+ *                Worst: Θ(h), h is the height of the subtree
+ */
+OrgTree::DepthFirstIterator& OrgTree::DepthFirstIterator::operator++()
+{
+	// descend first if we can
+	if (tree[node].leftmostChild != TREENULLPTR)
+	{
+		node = tree[node].leftmostChild;
+		return *this;
+	}
+	// otherwise climb until we find a right sibling, without leaving the subtree
+	while (node != subTreeRoot && tree[node].rightSibling == TREENULLPTR)
+	{
+		node = tree[node].parent;
+	}
+	node = (node == subTreeRoot) ? TREENULLPTR : tree[node].rightSibling;
+	return *this;
+}
+
 /**
  * Prints the contents of the entire tree to stdout.
  *
@@ -283,6 +426,9 @@ bool OrgTree::read(std::string filename)
 
 	// "erase" the tree's contents
 	size = 0;
+	root = TREENULLPTR;
+	levelCount = 0;
+	levelStart[0] = 0;
 
 	// get the root node
 	int lineNumber = 1;
@@ -414,7 +560,7 @@ void OrgTree::_writeSubTree(std::ofstream& file, TREENODEPTR subTreeRoot) const
  *
  * Precondition:  None.
  * Postcondition: The new node is inserted into the tree.
- * Performance:   Θ(n), n = number of child nodes of supervisor
+ * Performance:   Θ(n + h), n = number of child nodes of supervisor, h = height of the tree
  *
  * Returns:       The index of the newly added node, or TREENULLPTR if the node couldn't be added.
  */
@@ -427,9 +573,26 @@ TREENODEPTR OrgTree::hire(TREENODEPTR supervisor, std::string title, std::string
 		return TREENULLPTR;
 	}
 
+	TREENODEPTR node = _hire(supervisor, title, name);
+	levelInsert(node, (unsigned int) (tree[node].level - rootLevel));
+	return node;
+}
+
+/**
+ * Inserts a new node as the rightmost child of supervisor without updating
+ * the level-order index.
+ *
+ * Precondition:  supervisor is a valid node.
+ * Postcondition: The new node is linked into the tree, but not into the level-order index.
+ * Performance:   Θ(n), n = number of child nodes of supervisor
+ *
+ * Returns:       The index of the newly added node.
+ */
+TREENODEPTR OrgTree::_hire(TREENODEPTR supervisor, std::string title, std::string name)
+{
 	// insert the new hire as the rightmost child
 	ensureCapacity();
-	tree[size] = TreeNode{title, name, supervisor, TREENULLPTR, TREENULLPTR};
+	tree[size] = TreeNode{title, name, supervisor, TREENULLPTR, TREENULLPTR, tree[supervisor].level + 1};
 
 	if (tree[supervisor].leftmostChild == TREENULLPTR) // this is the first child
 	{
@@ -475,6 +638,24 @@ bool OrgTree::fire(std::string title)
 		return false;
 	}
 
+	_fire(index);
+
+	// the fired node's descendants all moved up a level
+	rebuildLevels();
+
+	return true;
+}
+
+/**
+ * Removes a non-root node without updating the level-order index.
+ * The last node in the array is moved into the removed node's slot.
+ *
+ * Precondition:  index is a valid node other than the root.
+ * Postcondition: The node is removed; the node that was at size - 1 is now at index.
+ * Performance:   Θ(n), n is the number of children of the node and of its parent
+ */
+void OrgTree::_fire(TREENODEPTR index)
+{
 	// update parent indices of children
 	for (TREENODEPTR currentChild = tree[index].leftmostChild;
 	     currentChild != TREENULLPTR; currentChild = tree[currentChild].rightSibling)
@@ -500,21 +681,33 @@ bool OrgTree::fire(std::string title)
 		tree[currentChild].rightSibling = tree[index].rightSibling;
 	}
 
-	// skip to rightmost sibling
 	TREENODEPTR currentChild = tree[tree[index].parent].leftmostChild;
-	while (tree[currentChild].rightSibling != TREENULLPTR)
+	if (currentChild == TREENULLPTR)
 	{
-		currentChild = tree[currentChild].rightSibling;
+		// we were an only child, so our children simply take our place
+		tree[tree[index].parent].leftmostChild = tree[index].leftmostChild;
+	}
+	else
+	{
+		// skip to rightmost sibling
+		while (tree[currentChild].rightSibling != TREENULLPTR)
+		{
+			currentChild = tree[currentChild].rightSibling;
+		}
+		// append deleted node's children to parent node's children
+		tree[currentChild].rightSibling = tree[index].leftmostChild;
 	}
-	// append deleted node's children to parent node's children
-	tree[currentChild].rightSibling = tree[index].leftmostChild;
-
-
 
 	// move last element in place of removed element
 	// this makes fire even more computationally expensive than it already is,
 	// but we don't have to keep track of empty slots in the array
 	tree[index] = tree[size - 1];
+	// the moved node's children have to follow it (unless we were the last element ourselves)
+	for (currentChild = (index == size - 1) ? TREENULLPTR : tree[index].leftmostChild;
+	     currentChild != TREENULLPTR; currentChild = tree[currentChild].rightSibling)
+	{
+		tree[currentChild].parent = index;
+	}
 	// if we move the root, we don't have to worry about parent or right sibling indices
 	if (tree[index].parent == TREENULLPTR) root = index;
 	else // fix indices
@@ -541,10 +734,311 @@ bool OrgTree::fire(std::string title)
 	}
 	// we can now pretend the last element is gone
 	size--;
+}
 
+/**
+ * Moves a node (along with its subtree) to become the rightmost child of a new supervisor.
+ *
+ * Precondition:  None.
+ * Postcondition: The node reports to supervisor if the move was valid.
+ * Performance:   Θ(n), n is the total number of nodes in the tree
+ *
+ * Returns:       true if the node was moved; false if the move was invalid.
+ */
+bool OrgTree::move(TREENODEPTR node, TREENODEPTR supervisor)
+{
+	if (node >= size || supervisor >= size)
+	{
+		std::cerr << "(move) Node " << ((node >= size) ? node : supervisor) << " does not exist." << std::endl;
+		return false;
+	}
+	if (!_move(node, supervisor)) return false;
+
+	// the whole subtree changed depth
+	rebuildLevels();
 	return true;
 }
 
+/**
+ * Moves a node (along with its subtree) without updating the level-order index.
+ * Moving a node to TREENULLPTR makes it the root, with the old root as its rightmost child.
+ *
+ * Precondition:  node is valid; supervisor is valid or TREENULLPTR.
+ * Postcondition: The node reports to supervisor if the move was valid.
+ * Performance:   Θ(h + n), h is the height of the tree, n is the number of
+ *                children of the node's old and new supervisors
+ *
+ * Returns:       true if the node was moved; false if it would have created a cycle.
+ */
+bool OrgTree::_move(TREENODEPTR node, TREENODEPTR supervisor)
+{
+	if (node == root)
+	{
+		if (supervisor == TREENULLPTR) return true;
+		std::cerr << "(move) Cannot move the root node under another node." << std::endl;
+		return false;
+	}
+
+	// a node can't report to someone in its own subtree
+	for (TREENODEPTR ancestor = supervisor; ancestor != TREENULLPTR; ancestor = tree[ancestor].parent)
+	{
+		if (ancestor == node)
+		{
+			std::cerr << "(move) Node " << node << " cannot report to its own subordinate." << std::endl;
+			return false;
+		}
+	}
+
+	// unlink from the old supervisor
+	TREENODEPTR oldSupervisor = tree[node].parent;
+	if (tree[oldSupervisor].leftmostChild == node)
+	{
+		tree[oldSupervisor].leftmostChild = tree[node].rightSibling;
+	}
+	else
+	{
+		TREENODEPTR currentChild = tree[oldSupervisor].leftmostChild;
+		while (tree[currentChild].rightSibling != node)
+		{
+			currentChild = tree[currentChild].rightSibling;
+		}
+		tree[currentChild].rightSibling = tree[node].rightSibling;
+	}
+	tree[node].rightSibling = TREENULLPTR;
+
+	// promoting to root: the old root becomes our rightmost child
+	TREENODEPTR child = node;
+	if (supervisor == TREENULLPTR)
+	{
+		child = root;
+		supervisor = node;
+		tree[node].parent = TREENULLPTR;
+		root = node;
+	}
+
+	// link as the rightmost child of the new supervisor
+	tree[child].parent = supervisor;
+	if (tree[supervisor].leftmostChild == TREENULLPTR)
+	{
+		tree[supervisor].leftmostChild = child;
+	}
+	else
+	{
+		TREENODEPTR currentChild = tree[supervisor].leftmostChild;
+		while (tree[currentChild].rightSibling != TREENULLPTR)
+		{
+			currentChild = tree[currentChild].rightSibling;
+		}
+		tree[currentChild].rightSibling = child;
+	}
+	return true;
+}
+
+/**
+ * Applies an edit script (usually produced by diff) to this tree in place.
+ * Edits only update parent pointers as they go; the child lists, the fired
+ * nodes' slots and the level-order index are all fixed up in one pass at the
+ * end, so no edit has to walk a sibling list.  Untouched nodes keep their
+ * indices and sibling order unless a fire moves them into a freed slot;
+ * hired and moved nodes become the rightmost child of their supervisor.
+ *
+ * Precondition:  Titles in this tree are unique.
+ * Postcondition: The edits are applied in order, stopping at the first invalid one.
+ * Performance:   Θ(n + k) expected, n is the total number of nodes in the tree, k is the number of edits
+ *                (plus Θ(h) per move to rule out cycles, h is the height of the tree)
+ *
+ * Returns:       true if every edit was applied; false otherwise.
+ */
+bool OrgTree::apply(const OrgPatch& patch)
+{
+	// index every title once so edits don't have to search the tree
+	std::unordered_map<std::string, TREENODEPTR> indices;
+	indices.reserve(size + patch.size());
+	for (TREENODEPTR i = 0; i < size; i++)
+	{
+		indices[tree[i].title] = i;
+	}
+
+	// siblings are rebuilt in rank order: existing children first (in their current order), then edits in order
+	std::vector<unsigned int> rank(size);
+	unsigned int rankCount = 0;
+	if (root != TREENULLPTR) rank[root] = rankCount++;
+	for (TREENODEPTR i = 0; i < size; i++)
+	{
+		for (TREENODEPTR currentChild = tree[i].leftmostChild;
+		     currentChild != TREENULLPTR; currentChild = tree[currentChild].rightSibling)
+		{
+			rank[currentChild] = rankCount++;
+		}
+	}
+	std::vector<char> fired(size, 0);
+
+	bool applied = true;
+	for (const OrgEdit& edit : patch)
+	{
+		auto node = indices.find(edit.title);
+		TREENODEPTR supervisor = TREENULLPTR;
+		if (!edit.supervisor.empty())
+		{
+			auto found = indices.find(edit.supervisor);
+			if (found == indices.end())
+			{
+				std::cerr << "(apply) Supervisor \"" << edit.supervisor << "\" does not exist." << std::endl;
+				applied = false;
+				break;
+			}
+			supervisor = found->second;
+		}
+
+		if (edit.kind == OrgEdit::HIRE)
+		{
+			if (node != indices.end())
+			{
+				std::cerr << "(apply) Node with title \"" << edit.title << "\" already exists." << std::endl;
+				applied = false;
+				break;
+			}
+			// only the parent pointer for now; the child lists are rebuilt at the end
+			ensureCapacity();
+			tree[size] = TreeNode{edit.title, edit.name, supervisor, TREENULLPTR, TREENULLPTR, 0};
+			if (supervisor == TREENULLPTR)
+			{
+				// a new root takes the old one as its child
+				if (root != TREENULLPTR) tree[root].parent = size;
+				root = size;
+			}
+			rank.push_back(rankCount++);
+			fired.push_back(0);
+			indices[edit.title] = size++;
+			continue;
+		}
+
+		if (node == indices.end())
+		{
+			std::cerr << "(apply) Node with title \"" << edit.title << "\" does not exist." << std::endl;
+			applied = false;
+			break;
+		}
+
+		if (edit.kind == OrgEdit::FIRE)
+		{
+			if (node->second == root)
+			{
+				std::cerr << "(apply) Cannot fire root node." << std::endl;
+				applied = false;
+				break;
+			}
+			// the node stays in the parent chain until the end, so its reports still find their way up
+			fired[node->second] = 1;
+			indices.erase(node);
+		}
+		else if (edit.kind == OrgEdit::MOVE)
+		{
+			TREENODEPTR index = node->second;
+			if (index == root)
+			{
+				if (supervisor == TREENULLPTR) continue;
+				std::cerr << "(move) Cannot move the root node under another node." << std::endl;
+				applied = false;
+				break;
+			}
+
+			// a node can't report to someone in its own subtree
+			TREENODEPTR ancestor = supervisor;
+			while (ancestor != TREENULLPTR && ancestor != index) ancestor = tree[ancestor].parent;
+			if (ancestor == index)
+			{
+				std::cerr << "(move) Node " << index << " cannot report to its own subordinate." << std::endl;
+				applied = false;
+				break;
+			}
+
+			if (supervisor == TREENULLPTR)
+			{
+				// promoting to root: the old root becomes our rightmost child
+				tree[root].parent = index;
+				rank[root] = rankCount++;
+				root = index;
+			}
+			tree[index].parent = supervisor;
+			rank[index] = rankCount++;
+		}
+		else // OrgEdit::RENAME
+		{
+			tree[node->second].name = edit.name;
+		}
+	}
+
+	_relink(fired, rank, rankCount);
+	rebuildLevels();
+	return applied;
+}
+
+/**
+ * Finishes apply: splices out the fired nodes, fills their slots from the end
+ * of the array, and rebuilds every child list from the parent pointers.
+ *
+ * Precondition:  Parent pointers are correct if fired nodes are skipped; the root is not fired.
+ * Postcondition: The tree only holds live nodes, linked in rank order.
+ * Performance:   Θ(n + r), n is the number of nodes, r is rankCount
+ */
+void OrgTree::_relink(const std::vector<char>& fired, std::vector<unsigned int>& rank, unsigned int rankCount)
+{
+	// skip over fired supervisors, remembering the answer for each fired node on the way
+	for (TREENODEPTR i = 0; i < size; i++)
+	{
+		TREENODEPTR supervisor = tree[i].parent;
+		while (supervisor != TREENULLPTR && fired[supervisor]) supervisor = tree[supervisor].parent;
+		for (TREENODEPTR skipped = tree[i].parent; skipped != supervisor; )
+		{
+			TREENODEPTR next = tree[skipped].parent;
+			tree[skipped].parent = supervisor;
+			skipped = next;
+		}
+		tree[i].parent = supervisor;
+	}
+
+	// fill each fired slot with the last live node, like fire does
+	std::vector<TREENODEPTR> newIndex(size);
+	for (TREENODEPTR i = 0; i < size; i++) newIndex[i] = i;
+	TREENODEPTR last = size - 1;
+	unsigned int liveCount = size;
+	for (TREENODEPTR i = 0; i < size; i++) if (fired[i]) liveCount--;
+	for (TREENODEPTR i = 0; i < liveCount; i++)
+	{
+		if (!fired[i]) continue;
+		while (fired[last]) last--;
+		tree[i] = std::move(tree[last]);
+		rank[i] = rank[last];
+		newIndex[last] = i;
+		last--;
+	}
+	size = liveCount;
+	for (TREENODEPTR i = 0; i < size; i++)
+	{
+		if (tree[i].parent != TREENULLPTR) tree[i].parent = newIndex[tree[i].parent];
+	}
+	if (root != TREENULLPTR) root = newIndex[root];
+
+	// relink the children in rank order, keeping track of each supervisor's rightmost child
+	std::vector<TREENODEPTR> byRank(rankCount, TREENULLPTR);
+	std::vector<TREENODEPTR> rightmost(size, TREENULLPTR);
+	for (TREENODEPTR i = 0; i < size; i++)
+	{
+		byRank[rank[i]] = i;
+		tree[i].leftmostChild = TREENULLPTR;
+		tree[i].rightSibling = TREENULLPTR;
+	}
+	for (TREENODEPTR child : byRank)
+	{
+		if (child == TREENULLPTR || child == root) continue;
+		TREENODEPTR supervisor = tree[child].parent;
+		if (rightmost[supervisor] == TREENULLPTR) tree[supervisor].leftmostChild = child;
+		else tree[rightmost[supervisor]].rightSibling = child;
+		rightmost[supervisor] = child;
+	}
+}
+
 /**
  * Ensures that there is room in the underlying array to insert another item
  *
@@ -559,16 +1053,135 @@ void OrgTree::ensureCapacity()
 	if (capacity < size + 1)
 	{
 		// create a new tree with twice the capacity
+		unsigned int oldCapacity = capacity;
 		capacity <<= 1;
-		TreeNode *newTree = new TreeNode[capacity];
+		TreeNode *newTree = allocateArray<TreeNode>(capacity);
+		TREENODEPTR *newLevelOrder = allocateArray<TREENODEPTR>(capacity);
+		unsigned int *newLevelStart = allocateArray<unsigned int>(capacity + 1);
 
-		// copy the tree contents
+		// move the tree contents (the old strings are about to be destroyed anyway)
 		for (int i = 0; i < size; i++)
 		{
-			newTree[i] = tree[i];
+			newTree[i] = std::move(tree[i]);
+			newLevelOrder[i] = levelOrder[i];
+		}
+		for (int i = 0; i <= levelCount; i++)
+		{
+			newLevelStart[i] = levelStart[i];
 		}
 		// point to the new tree
-		delete[] tree;
+		freeArray(tree, oldCapacity);
+		freeArray(levelOrder, oldCapacity);
+		freeArray(levelStart, oldCapacity + 1);
 		tree = newTree;
+		levelOrder = newLevelOrder;
+		levelStart = newLevelStart;
+	}
+}
+
+/**
+ * Allocates and default-constructs an array, from the arena if there is one.
+ *
+ * Precondition:  None.
+ * Postcondition: The caller must release the array with freeArray.
+ * Performance:   Θ(n), n is the number of elements
+ *
+ * Returns:       The new array.
+ */
+template<class T> T *OrgTree::allocateArray(unsigned int count)
+{
+	void *memory = (arena != nullptr) ? arena->allocate(count * sizeof(T), alignof(T))
+	                                  : ::operator new(count * sizeof(T));
+	T *array = static_cast<T *>(memory);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		new (array + i) T();
+	}
+	return array;
+}
+
+/**
+ * Destroys an array made by allocateArray.  Arena memory is only reclaimed
+ * when the whole arena is released.
+ *
+ * Precondition:  The array was allocated by this tree with the same count.
+ * Postcondition: The elements are destroyed and heap memory is freed.
+ * Performance:   Θ(n), n is the number of elements
+ */
+template<class T> void OrgTree::freeArray(T *array, unsigned int count)
+{
+	for (unsigned int i = 0; i < count; i++)
+	{
+		array[i].~T();
+	}
+	if (arena == nullptr) ::operator delete(array);
+}
+
+/**
+ * Adds a node to the end of a level in the level-order index.
+ * Every deeper level is rotated one slot to the right by moving its first node
+ * to its end, so only one node per level has to move.
+ *
+ * Precondition:  There is room in levelOrder for one more node, and depth <= levelCount.
+ * Postcondition: The node is in the level-order index at the given depth.
+ * Performance:   Θ(h), h is the height of the tree
+ */
+void OrgTree::levelInsert(TREENODEPTR node, unsigned int depth)
+{
+	// the node starts a new deepest level
+	if (depth == levelCount)
+	{
+		levelStart[levelCount + 1] = levelStart[levelCount];
+		levelCount++;
+	}
+
+	// the free slot starts just past the deepest level and bubbles up to the target level
+	unsigned int hole = levelStart[levelCount]++;
+	for (unsigned int d = levelCount - 1; d > depth; d--)
+	{
+		if (levelStart[d] != hole) // empty levels don't need to move anything
+		{
+			levelOrder[hole] = levelOrder[levelStart[d]];
+			hole = levelStart[d];
+		}
+		levelStart[d]++;
+	}
+
+	levelOrder[hole] = node;
+}
+
+/**
+ * Recomputes every node's depth and the level-order index from scratch.
+ * The index itself is used as the breadth-first queue, so nothing is allocated.
+ *
+ * Precondition:  None.
+ * Postcondition: The level-order index holds the tree in breadth-first order.
+ * Performance:   Θ(n), n is the total number of nodes in the tree
+ */
+void OrgTree::rebuildLevels()
+{
+	levelCount = 0;
+	levelStart[0] = 0;
+	if (root == TREENULLPTR) return;
+
+	rootLevel = 0;
+	levelOrder[0] = root;
+	unsigned int tail = 1;
+	for (unsigned int head = 0; head < tail; head++)
+	{
+		// the queue has drained the previous level, so everything queued after it is one level deeper
+		if (head == levelStart[levelCount])
+		{
+			levelCount++;
+			levelStart[levelCount] = tail;
+		}
+
+		TREENODEPTR node = levelOrder[head];
+		tree[node].level = levelCount - 1;
+		for (TREENODEPTR currentChild = tree[node].leftmostChild;
+		     currentChild != TREENULLPTR; currentChild = tree[currentChild].rightSibling)
+		{
+			levelOrder[tail++] = currentChild;
+		}
 	}
 }
\ No newline at end of file
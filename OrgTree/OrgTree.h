@@ -2,8 +2,8 @@
  * Organization Tree
  *
  * Stores a set of nodes representing employees in an organization.
- * Space overhead: 3n+4 words for a full array
- *                 (~16% overhead assuming 16 words of data per node)
+ * Space overhead: 6n+10 words for a full array
+ *                 (~27% overhead assuming 16 words of data per node)
  *
  * Author: Jonathan Zentgraf
  */
@@ -14,7 +14,11 @@
 #define TREENODEPTR int
 #define TREENULLPTR -1
 
+#include "OrgPatch.h"
 #include <string>
+#include <vector>
+
+class OrgArena;
 
 struct TreeNode
 {
@@ -23,6 +27,7 @@ struct TreeNode
 	TREENODEPTR parent;
 	TREENODEPTR leftmostChild;
 	TREENODEPTR rightSibling;
+	int level;  // depth relative to OrgTree::rootLevel (see OrgTree::depth)
 };
 
 class OrgTree
@@ -33,17 +38,106 @@ private:
 	TREENODEPTR root = TREENULLPTR;
 	TreeNode *tree;
 
+	// level-order index: levelOrder holds every node grouped by depth, and the
+	// nodes at depth d occupy [levelStart[d], levelStart[d + 1])
+	TREENODEPTR *levelOrder;
+	unsigned int *levelStart;
+	unsigned int levelCount = 0;
+	// stored levels are relative to this so addRoot doesn't have to touch every node
+	int rootLevel = 0;
+
+	// storage comes from here when set, otherwise from the global heap
+	OrgArena *arena = nullptr;
+
+	template<class T> T *allocateArray(unsigned int count);
+
+	template<class T> void freeArray(T *array, unsigned int count);
+
 	void ensureCapacity();
 
+	void levelInsert(TREENODEPTR node, unsigned int depth);
+
+	void rebuildLevels();
+
 	void _printSubTree(TREENODEPTR subTreeRoot, int level) const;
 
 	void _writeSubTree(std::ofstream& file, TREENODEPTR subTreeRoot) const;
 
+	TREENODEPTR _hire(TREENODEPTR supervisor, std::string title, std::string name);
+
+	void _fire(TREENODEPTR index);
+
+	bool _move(TREENODEPTR node, TREENODEPTR supervisor);
+
+	void _relink(const std::vector<char>& fired, std::vector<unsigned int>& rank, unsigned int rankCount);
+
 public:
+	/**
+	 * A contiguous run of node indices, usable with range-for.
+	 */
+	class NodeRange
+	{
+	private:
+		const TREENODEPTR *first;
+		const TREENODEPTR *last;
+
+	public:
+		NodeRange(const TREENODEPTR *first, const TREENODEPTR *last) : first(first), last(last) {}
+
+		const TREENODEPTR *begin() const { return first; }
+
+		const TREENODEPTR *end() const { return last; }
+
+		unsigned int size() const { return (unsigned int) (last - first); }
+	};
+
+	/**
+	 * Preorder iterator over a subtree.  Walks the parent pointers instead of
+	 * keeping a stack, so it never allocates.
+	 */
+	class DepthFirstIterator
+	{
+	private:
+		const TreeNode *tree;
+		TREENODEPTR node;
+		TREENODEPTR subTreeRoot;
+
+	public:
+		DepthFirstIterator(const TreeNode *tree, TREENODEPTR node, TREENODEPTR subTreeRoot)
+				: tree(tree), node(node), subTreeRoot(subTreeRoot) {}
+
+		TREENODEPTR operator*() const { return node; }
+
+		DepthFirstIterator& operator++();
+
+		bool operator==(const DepthFirstIterator& other) const { return node == other.node; }
+
+		bool operator!=(const DepthFirstIterator& other) const { return node != other.node; }
+	};
+
+	class DepthFirstRange
+	{
+	private:
+		DepthFirstIterator first;
+
+	public:
+		DepthFirstRange(const DepthFirstIterator& first) : first(first) {}
+
+		DepthFirstIterator begin() const { return first; }
+
+		DepthFirstIterator end() const { return DepthFirstIterator(nullptr, TREENULLPTR, TREENULLPTR); }
+	};
+
 	OrgTree();
 
+	explicit OrgTree(OrgArena *arena);
+
 	~OrgTree();
 
+	OrgTree(const OrgTree&) = delete;
+
+	OrgTree& operator=(const OrgTree&) = delete;
+
 	TREENODEPTR addRoot(std::string title, std::string name);
 
 	unsigned int getSize() const;
@@ -60,6 +154,16 @@ public:
 
 	std::string name(TREENODEPTR node) const;
 
+	int depth(TREENODEPTR node) const;
+
+	unsigned int getHeight() const;
+
+	NodeRange level(unsigned int depth) const;
+
+	NodeRange breadthFirst() const;
+
+	DepthFirstRange depthFirst(TREENODEPTR subTreeRoot) const;
+
 	void print() const;
 
 	void printSubTree(TREENODEPTR subTreeRoot) const;
@@ -75,6 +179,10 @@ public:
 	TREENODEPTR hire(TREENODEPTR supervisor, std::string title, std::string name);
 
 	bool fire(std::string title);
+
+	bool move(TREENODEPTR node, TREENODEPTR supervisor);
+
+	bool apply(const OrgPatch& patch);
 };
 
 
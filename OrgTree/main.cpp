@@ -1,5 +1,6 @@
 #include <iostream>
 #include "OrgTree.h"
+#include "OrgForest.h"
 
 using namespace std;
 
@@ -60,6 +61,18 @@ int main() {
 
 	t2->print();
 
+	for (unsigned int d = 0; d < t2->getHeight(); d++)
+	{
+		std::cout << "Level " << d << ":";
+		for (TREENODEPTR node : t2->level(d)) std::cout << " " << t2->title(node);
+		std::cout << std::endl;
+	}
+	for (TREENODEPTR node : t2->depthFirst(t2->find("CEO")))
+	{
+		std::cout << t2->depth(node) << " " << t2->title(node) << std::endl;
+	}
+	std::cout << std::endl;
+
 	t2->fire("1");
 	t2->print();
 	t2->fire("4");
@@ -70,4 +83,38 @@ int main() {
 	t2->print();
 	t2->fire("Numbers Guy");
 	t2->print();
+	std::cout << std::endl;
+
+	OrgForest forest;
+	OrgForest::Handle acme = forest.addTenant("acme");
+	{
+		OrgForest::Access org = forest.access(acme);
+		org->read("test");
+		org->hire(org->find("CEO"), "Tenant Intern", "Pat");
+		org->print();
+	}
+	{
+		// syncing one tenant from another needs both trees at once
+		OrgForest::Handle staging = forest.addTenant("acme-staging");
+		std::pair<OrgForest::Access, OrgForest::Access> orgs = forest.access(acme, staging);
+		orgs.second->read("test");
+		orgs.second->apply(diff(*orgs.second, *orgs.first));
+		std::cout << orgs.second->getSize() << " employees in staging" << std::endl;
+	}
+	forest.evict(acme);
+	std::cout << (forest.access(acme) ? "still here" : "evicted") << std::endl;
+
+	OrgTree upstream;
+	upstream.read("test");
+	upstream.fire("Butts");
+	upstream.hire(upstream.find("Numbers Guy"), "Numbers Intern", "Lee");
+	upstream.move(upstream.find("Twerking Intern"), upstream.find("CEO"));
+	OrgTree local;
+	local.read("test");
+	OrgPatch patch = diff(local, upstream);
+	std::cout << patch.size() << " edits" << std::endl;
+	local.apply(patch);
+	local.print();
+
+	delete t2;
 }
\ No newline at end of file
@@ -0,0 +1,197 @@
+#pragma once
+
+//Programmer-tested
+
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "MagicBag.h"
+
+/*
+ * Hands every thread a small number of its own, assigned round-robin the
+ * first time it asks.  Bags map it onto one of their shards.
+ */
+inline unsigned int currentThreadSlot()
+{
+    static std::atomic<unsigned int> nextSlot(0);
+    thread_local unsigned int slot = nextSlot.fetch_add(1, std::memory_order_relaxed);
+    return slot;
+}
+
+/*
+ * A MagicBag that many threads can insert into and draw from at once.
+ *
+ * The items are spread over shards, each an ordinary MagicBag with its own
+ * lock and random engine.  A thread only ever inserts into and draws from
+ * its home shard, so with one shard per core those locks are uncontended:
+ * taking one is a single atomic exchange, and no two threads fight over the
+ * same cache lines.  A thread whose shard runs dry steals half of a random
+ * victim's items, so it doesn't have to come back for every draw.
+ *
+ * Draws are uniform within a shard but not across the whole bag, which is
+ * the price of not funneling everyone through one lock.  getSize() and
+ * peek() look at the shards one at a time, so while other threads are busy
+ * they're only approximately right.
+ */
+template<class T, class Engine = Pcg32> class ConcurrentMagicBag
+{
+public:
+
+    explicit ConcurrentMagicBag(unsigned int shardCount = std::thread::hardware_concurrency())
+        : shardCount((shardCount == 0) ? 1 : shardCount), shards(new Shard[this->shardCount])
+    {
+    }
+
+    ConcurrentMagicBag(const ConcurrentMagicBag&) = delete;
+    ConcurrentMagicBag& operator=(const ConcurrentMagicBag&) = delete;
+
+    void insert(const T& item)
+    {
+        Shard& shard = home();
+        std::lock_guard<std::mutex> guard(shard.lock);
+        shard.bag.insert(item);
+        shard.count.store(shard.bag.getSize(), std::memory_order_relaxed);
+    }
+
+    void insert(T&& item)
+    {
+        Shard& shard = home();
+        std::lock_guard<std::mutex> guard(shard.lock);
+        shard.bag.insert(std::move(item));
+        shard.count.store(shard.bag.getSize(), std::memory_order_relaxed);
+    }
+
+    //draws an item, or returns false if every shard looked empty
+    bool tryDraw(T& item)
+    {
+        Shard& shard = home();
+        {
+            std::lock_guard<std::mutex> guard(shard.lock);
+            if (shard.bag.getSize() > 0)
+            {
+                item = shard.bag.draw();
+                shard.count.store(shard.bag.getSize(), std::memory_order_relaxed);
+                return true;
+            }
+        }
+
+        //our shard ran dry, so go steal
+        std::vector<T> loot;
+        if (!steal(shard, loot)) return false;
+        item = keepOne(shard, loot);
+        return true;
+    }
+
+    T draw()
+    {
+        //same as tryDraw, but builds the result straight from the drawn item (T needn't be default-constructible)
+        Shard& shard = home();
+        {
+            std::lock_guard<std::mutex> guard(shard.lock);
+            if (shard.bag.getSize() > 0)
+            {
+                T item = shard.bag.draw();
+                shard.count.store(shard.bag.getSize(), std::memory_order_relaxed);
+                return item;
+            }
+        }
+
+        std::vector<T> loot;
+        if (!steal(shard, loot)) throw "Empty array";
+        return keepOne(shard, loot);
+    }
+
+    int peek(const T& item) const
+    {
+        int count = 0;
+        for (unsigned int i = 0; i < shardCount; i++)
+        {
+            std::lock_guard<std::mutex> guard(shards[i].lock);
+            count += shards[i].bag.peek(item);
+        }
+        return count;
+    }
+
+    int getSize() const
+    {
+        //no locks at all: just add up what each shard last reported
+        int size = 0;
+        for (unsigned int i = 0; i < shardCount; i++)
+        {
+            size += shards[i].count.load(std::memory_order_relaxed);
+        }
+        return size;
+    }
+
+private:
+
+    struct Shard
+    {
+        mutable std::mutex lock;
+        MagicBag<T, Engine> bag;
+        std::atomic<int> count;
+        //keep neighbouring shards' locks off each other's cache lines
+        char padding[64];
+
+        Shard() : count(0) {}
+    };
+
+    unsigned int shardCount;
+    std::unique_ptr<Shard[]> shards;
+
+    Shard& home()
+    {
+        return shards[currentThreadSlot() % shardCount];
+    }
+
+    static Engine seededEngine()
+    {
+        Engine engine;
+        seedEngine(engine, freshSeed());
+        return engine;
+    }
+
+    //keeps one of the stolen items for the caller and stashes the rest at home
+    T keepOne(Shard& shard, std::vector<T>& loot)
+    {
+        T item(std::move(loot.back()));
+        loot.pop_back();
+        std::lock_guard<std::mutex> guard(shard.lock);
+        shard.bag.insert(std::make_move_iterator(loot.begin()), std::make_move_iterator(loot.end()));
+        shard.count.store(shard.bag.getSize(), std::memory_order_relaxed);
+        return item;
+    }
+
+    bool steal(Shard& thief, std::vector<T>& loot)
+    {
+        //each thread picks its victims with its own engine, so picking is lock-free too
+        thread_local Engine victimPicker = seededEngine();
+
+        /*
+         * Start at a random shard and go around once, skipping shards that
+         * look empty without locking them.
+         */
+        unsigned int start = boundedRandom(victimPicker, shardCount);
+        for (unsigned int i = 0; i < shardCount; i++)
+        {
+            Shard& victim = shards[(start + i) % shardCount];
+            if (&victim == &thief || victim.count.load(std::memory_order_relaxed) == 0) continue;
+
+            std::lock_guard<std::mutex> guard(victim.lock);
+            int available = victim.bag.getSize();
+            if (available == 0) continue;
+
+            //take half (rounded up) so we don't have to come back right away
+            int taken = available - available / 2;
+            loot.reserve(taken);
+            victim.bag.draw(taken, std::back_inserter(loot));
+            victim.count.store(victim.bag.getSize(), std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+};
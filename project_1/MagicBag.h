@@ -3,66 +3,174 @@
 //Programmer-tested
 //Valgrind-approved
 
+#include <cstdint>
 #include <cstdlib>
-#include <ctime>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <new>
 #include <string>
+#include <type_traits>
+#include <unordered_map>
 #include <utility>
 
+#include "MagicRandom.h"
+#include "MagicSimd.h"
+
 #define DEFAULT_CAPACITY 10
+#define DRAW_BATCH 64
+
+/*
+ * Hasher tag for bags that don't keep a multiplicity index (the default).
+ * Their peek() just counts by scanning the contents.
+ */
+struct NoCounting {};
 
-template<class T> class MagicBag
+/*
+ * Keeps a running count of every distinct item in a bag so peek() doesn't
+ * have to scan.  It costs a hash map entry per distinct item and a hash on
+ * every insert and draw.
+ */
+template<class T, class Hash> class BagCounter
+{
+public:
+
+    static const bool enabled = true;
+
+    void add(const T& item)
+    {
+        counts[item]++;
+    }
+
+    void remove(const T& item)
+    {
+        //drop items that run out so the map doesn't fill up with zeroes
+        typename std::unordered_map<T, int, Hash>::iterator entry = counts.find(item);
+        if (--entry->second == 0) counts.erase(entry);
+    }
+
+    int count(const T& item) const
+    {
+        typename std::unordered_map<T, int, Hash>::const_iterator entry = counts.find(item);
+        return (entry == counts.end()) ? 0 : entry->second;
+    }
+
+    void swap(BagCounter& other)
+    {
+        counts.swap(other.counts);
+    }
+
+private:
+
+    std::unordered_map<T, int, Hash> counts;
+};
+
+template<class T> class BagCounter<T, NoCounting>
+{
+public:
+
+    static const bool enabled = false;
+
+    void add(const T&) {}
+    void remove(const T&) {}
+    int count(const T&) const { return 0; }
+    void swap(BagCounter&) {}
+};
+
+/*
+ * Every bag owns its own random engine, so bags never share (or reseed)
+ * global state and draws on different threads don't contend.  Any standard
+ * engine with 32 or more bits of output can be plugged in.
+ * Passing a hasher (see CountingMagicBag) makes peek() O(1).
+ *
+ * The contents live in raw, uninitialized memory: only the first 'size' slots
+ * hold constructed items, so a bag of strings doesn't build 'capacity' empty
+ * strings up front.
+ */
+template<class T, class Engine = Pcg32, class Hash = NoCounting> class MagicBag
 {
 public:
 
     MagicBag()
     {
-        //seed the PRNG
-        srand((unsigned int)time(nullptr));
+        //give the PRNG its own stream
+        seed(freshSeed());
 
         //set sane default values
         this->size = 0;
         this->capacity = DEFAULT_CAPACITY;
-        contents = new T[DEFAULT_CAPACITY];
+        contents = allocate(DEFAULT_CAPACITY);
     }
 
     MagicBag(int initialCapacity)
     {
-        //seed the PRNG
-        srand((unsigned int)time(nullptr));
+        //give the PRNG its own stream
+        seed(freshSeed());
 
         //set initial values
         this->size = 0;
         this->capacity = initialCapacity;
-        contents = new T[capacity];
+        contents = allocate(capacity);
     }
     
+    MagicBag(int initialCapacity, std::uint64_t seedValue)
+    {
+        //explicitly seeded bags draw the same sequence every run
+        seed(seedValue);
+
+        //set initial values
+        this->size = 0;
+        this->capacity = initialCapacity;
+        contents = allocate(capacity);
+    }
+
     MagicBag(const MagicBag& other)
     {
-        //seed the PRNG
-        srand((unsigned int)time(nullptr));
+        //a copy gets its own stream instead of replaying the original's draws
+        seed(freshSeed());
 
-        //copy the bag contents
+        //copy the index first: if that throws, there's nothing of ours to clean up yet
+        counter = other.counter;
+
+        //copy the bag contents (this turns into a memcpy for simple types)
         size = other.size;
         capacity = other.capacity;
-        contents = new T[capacity];
-        for (int i = 0; i < size; i++)
+        contents = allocate(capacity);
+        try
+        {
+            std::uninitialized_copy(other.contents, other.contents + size, contents);
+        }
+        catch (...)
         {
-            contents[i] = other.contents[i];
+            std::free(contents);
+            throw;
         }
     }
+
+    MagicBag(MagicBag&& other) noexcept
+        : size(other.size), capacity(other.capacity), contents(other.contents),
+          engine(other.engine), counter(std::move(other.counter))
+    {
+        //steal the array and leave the other bag empty (but still usable)
+        other.size = 0;
+        other.capacity = 0;
+        other.contents = nullptr;
+
+        //the other bag mustn't go on replaying the stream we just took
+        other.seed(freshSeed());
+    }
     
     ~MagicBag()
     {
-        //we only need to clean up our array
-        delete[] contents;
+        //destroy the items we actually hold, then free the raw memory
+        destroy(contents, contents + size);
+        std::free(contents);
     }
 
-    MagicBag& operator=(const MagicBag& other)
+    MagicBag& operator=(MagicBag other)
     {
-        //copy-and-swap
-        MagicBag copy(other);
-        swap(*this, copy);
+        //copy-and-swap (or move-and-swap, since other is taken by value)
+        swap(*this, other);
 
         return *this;
     }
@@ -73,69 +181,142 @@ public:
         std::swap(a.size, b.size);
         std::swap(a.capacity, b.capacity);
         std::swap(a.contents, b.contents);
+        std::swap(a.engine, b.engine);
+        a.counter.swap(b.counter);
+    }
+
+    void seed(std::uint64_t seedValue)
+    {
+        seedEngine(engine, seedValue);
+    }
+
+    void insert(const T& item)
+    {
+        emplace(item);
+    }
+
+    void insert(T&& item)
+    {
+        emplace(std::move(item));
+    }
+
+    //inserts a whole range with at most one reallocation (the range can't come from this bag)
+    template<class InputIt, class = typename std::iterator_traits<InputIt>::iterator_category>
+    void insert(InputIt first, InputIt last)
+    {
+        insertRange(first, last, typename std::iterator_traits<InputIt>::iterator_category());
+    }
+
+    void reserve(int newCapacity)
+    {
+        if (capacity < newCapacity) relocate(newCapacity, std::is_trivially_copyable<T>());
     }
 
-    void insert(T item)
+    template<class... Args> void emplace(Args&&... args)
     {
         //check if we need to allocate more memory
         if (capacity < (size + 1)) {
             /*
-             * This is the JDK's method of doing this in ArrayList
-             * It's equivalent to 'capacity *= 1.5;'
-             * (capacity >> 1) is the same as capacity/2, but faster to perform
-             * than a division.
-             * I trust the factor of 1.5 to be a good choice if the JDK
-             * developers find that they believe it is after having many years
-             * to try to optimize the ArrayList class.
+             * The arguments might refer to an item that's already in the bag,
+             * so build the new item before the old array goes away.
              */
-            capacity = capacity + (capacity >> 1);
-
-            /*
-             * I just want to make a quick note here that I'm really sad that
-             * there isn't an equivalent to realloc in C++.
-             */
-            //create a new, larger array
-            T *newContents = new T[capacity];
-            //copy the array contents
-            for (int i = 0; i < size; i++)
-            {
-                newContents[i] = contents[i];
-            }
-            //replace the old array with the new one
-            delete[] contents; //leave no memory behind
-            contents = newContents;
+            T item(std::forward<Args>(args)...);
+            grow();
+            new (contents + size) T(std::move(item));
+        }
+        else
+        {
+            //construct the new item right in its slot
+            new (contents + size) T(std::forward<Args>(args)...);
         }
 
-        //insert the new item
-        contents[size] = item;
-        size++;
+        keepLast();
     }
 
     T draw()
     {
         if (size == 0) throw "Empty array";
 
-        //choose a random item
-        int index = rand() % size;
-        T item = contents[index];
+        //choose a random item (unbiased, unlike rand() % size)
+        int index = (int)boundedRandom(engine, (std::uint32_t)size);
+        T item(std::move(contents[index]));
+        counter.remove(item);
 
-        //overwrite the drawn item with the item in the last slot
+        //fill the hole with the item in the last slot
         size--;
-        contents[index] = contents[size];
+        if (index != size) contents[index] = std::move(contents[size]);
+        contents[size].~T();
 
         return item;
     }
 
+    //draws k items without replacement, writing them to out
+    template<class OutputIt> OutputIt draw(int k, OutputIt out)
+    {
+        if (k > size) throw "Not enough items";
+
+        /*
+         * This is a partial Fisher-Yates shuffle: each step picks one of the
+         * items that are left and backfills its slot from the end, exactly
+         * like draw().  Since the number of items left at each step is known
+         * ahead of time, we pick a whole batch of indices first (two per
+         * random number on small bags) and prefetch them, so the cache misses
+         * overlap instead of happening one at a time.
+         */
+        std::uint32_t indices[DRAW_BATCH];
+        while (k > 0)
+        {
+            int batch = (k < DRAW_BATCH) ? k : DRAW_BATCH;
+            std::uint32_t remaining = (std::uint32_t)size;
+            int picked = 0;
+            while (picked < batch)
+            {
+                if (batch - picked >= 2 && remaining <= 0x10000u)
+                {
+                    boundedRandomPair(engine, remaining, remaining - 1, indices[picked], indices[picked + 1]);
+                    remaining -= 2;
+                    picked += 2;
+                }
+                else
+                {
+                    indices[picked++] = boundedRandom(engine, remaining--);
+                }
+            }
+#ifdef __GNUC__
+            for (int i = 0; i < batch; i++) __builtin_prefetch(contents + indices[i], 1);
+#endif
+
+            for (int i = 0; i < batch; i++) out = drawAt((int)indices[i], out);
+            k -= batch;
+        }
+
+        return out;
+    }
+
     int peek(T item) const
     {
-        int count = 0;
-        
-        for (int i = 0; i < size; i++)
+        //counting bags already know the answer
+        if (BagCounter<T, Hash>::enabled) return counter.count(item);
+
+        //ints and floats get a SIMD scan, everything else a plain loop
+        return countEqual(contents, size, item);
+    }
+
+    //counts each of several items, sharing passes over the contents between them
+    void peekMany(const T* items, int itemCount, int* counts) const
+    {
+        if (BagCounter<T, Hash>::enabled)
         {
-            if (contents[i] == item) count++;
+            for (int i = 0; i < itemCount; i++) counts[i] = counter.count(items[i]);
+            return;
         }
 
-        return count;
+        countEqualMany(contents, size, items, itemCount, counts);
+    }
+
+    int getSize() const
+    {
+        return size;
     }
 
     void print(std::ostream& os) const
@@ -148,11 +329,144 @@ private:
     int size;
     int capacity;
     T *contents;
+    Engine engine;
+    BagCounter<T, Hash> counter;
+
+    static T *allocate(int count)
+    {
+        //raw memory: nothing gets constructed until it's inserted
+        if (count == 0) return nullptr;
+        void *memory = std::malloc(count * sizeof(T));
+        if (memory == nullptr) throw std::bad_alloc();
+        return static_cast<T *>(memory);
+    }
+
+    static void destroy(T *first, T *last)
+    {
+        if (std::is_trivially_destructible<T>::value) return;
+        for (; first != last; ++first) first->~T();
+    }
+
+    void keepLast()
+    {
+        //counts the item just built past the end; if that throws, the item goes away again
+        try
+        {
+            counter.add(contents[size]);
+        }
+        catch (...)
+        {
+            contents[size].~T();
+            throw;
+        }
+        size++;
+    }
+
+    template<class OutputIt> OutputIt drawAt(int index, OutputIt out)
+    {
+        counter.remove(contents[index]);
+        *out = std::move(contents[index]);
+        ++out;
+
+        //fill the hole with the item in the last slot
+        size--;
+        if (index != size) contents[index] = std::move(contents[size]);
+        contents[size].~T();
+
+        return out;
+    }
+
+    template<class InputIt> void insertRange(InputIt first, InputIt last, std::input_iterator_tag)
+    {
+        //we can't know how many there are without consuming them
+        for (; first != last; ++first) emplace(*first);
+    }
+
+    template<class ForwardIt> void insertRange(ForwardIt first, ForwardIt last, std::forward_iterator_tag)
+    {
+        //grow once, to at least the usual 1.5x so that later inserts stay cheap
+        int needed = size + (int)std::distance(first, last);
+        if (capacity < needed)
+        {
+            int grown = capacity + (capacity >> 1);
+            reserve((grown < needed) ? needed : grown);
+        }
+
+        for (; first != last; ++first)
+        {
+            new (contents + size) T(*first);
+            keepLast();
+        }
+    }
+
+    void grow()
+    {
+        /*
+         * This is the JDK's method of doing this in ArrayList
+         * It's equivalent to 'capacity *= 1.5;'
+         * (capacity >> 1) is the same as capacity/2, but faster to perform
+         * than a division.
+         * I trust the factor of 1.5 to be a good choice if the JDK
+         * developers find that they believe it is after having many years
+         * to try to optimize the ArrayList class.
+         */
+        int newCapacity = capacity + (capacity >> 1);
+        //tiny (or moved-from) bags wouldn't grow at all otherwise
+        if (newCapacity < DEFAULT_CAPACITY) newCapacity = DEFAULT_CAPACITY;
+        relocate(newCapacity, std::is_trivially_copyable<T>());
+    }
+
+    void relocate(int newCapacity, std::true_type /*trivially copyable*/)
+    {
+        /*
+         * I just want to make a quick note here that I'm really sad that
+         * there isn't an equivalent to realloc in C++.
+         * (It turns out there is, as long as T is trivially copyable.)
+         */
+        void *memory = std::realloc(contents, newCapacity * sizeof(T));
+        if (memory == nullptr) throw std::bad_alloc();
+        contents = static_cast<T *>(memory);
+        capacity = newCapacity;
+    }
+
+    void relocate(int newCapacity, std::false_type /*trivially copyable*/)
+    {
+        //create a new, larger array
+        T *newContents = allocate(newCapacity);
+        //move the array contents (or copy them, if moving could throw and lose items)
+        int moved = 0;
+        try
+        {
+            for (; moved < size; moved++)
+            {
+                new (newContents + moved) T(std::move_if_noexcept(contents[moved]));
+            }
+        }
+        catch (...)
+        {
+            destroy(newContents, newContents + moved);
+            std::free(newContents);
+            throw;
+        }
+        //replace the old array with the new one
+        destroy(contents, contents + size);
+        std::free(contents); //leave no memory behind
+        contents = newContents;
+        capacity = newCapacity;
+    }
 
     friend std::ostream& operator<<(std::ostream& os, const MagicBag& mb)
     {
         os << "{";
         for (int i = 0; i < (mb.size - 1); i++) os << mb.contents[i] << ", ";
-        return os << mb.contents[mb.size - 1] << "}";
+        if (mb.size > 0) os << mb.contents[mb.size - 1];
+        return os << "}";
     }
 };
+
+/*
+ * A MagicBag that keeps a multiplicity index, so peek() is a hash lookup
+ * instead of a scan.
+ */
+template<class T, class Hash = std::hash<T>, class Engine = Pcg32>
+using CountingMagicBag = MagicBag<T, Engine, Hash>;
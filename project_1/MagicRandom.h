@@ -0,0 +1,159 @@
+#pragma once
+
+//Programmer-tested
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/*
+ * PCG32 (XSH RR variant) from Melissa O'Neill's PCG family.
+ * It's 16 bytes of state, a multiply and an add per number, and passes the
+ * statistical test suites that rand() fails.  It satisfies the standard
+ * UniformRandomBitGenerator requirements, so it works with <random> too.
+ */
+class Pcg32
+{
+public:
+
+    typedef std::uint32_t result_type;
+
+    Pcg32()
+    {
+        seed(0x853c49e6748fea9bULL, 0xda3e39cb94b95bdbULL);
+    }
+
+    explicit Pcg32(std::uint64_t seedValue, std::uint64_t stream = 0xda3e39cb94b95bdbULL)
+    {
+        seed(seedValue, stream);
+    }
+
+    void seed(std::uint64_t seedValue, std::uint64_t stream = 0xda3e39cb94b95bdbULL)
+    {
+        //the increment has to be odd; different increments give independent streams
+        state = 0;
+        increment = (stream << 1) | 1;
+        (*this)();
+        state += seedValue;
+        (*this)();
+    }
+
+    result_type operator()()
+    {
+        std::uint64_t old = state;
+        state = old * 6364136223846793005ULL + increment;
+        std::uint32_t xorShifted = (std::uint32_t)(((old >> 18) ^ old) >> 27);
+        std::uint32_t rotation = (std::uint32_t)(old >> 59);
+        return (xorShifted >> rotation) | (xorShifted << ((32 - rotation) & 31));
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return 0xFFFFFFFFu; }
+
+private:
+
+    std::uint64_t state;
+    std::uint64_t increment;
+};
+
+/*
+ * SplitMix64 finalizer, used to turn weak seed material (clock ticks and a
+ * counter) into well-mixed seeds.
+ */
+inline std::uint64_t mixSeed(std::uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/*
+ * Produces a different seed on every call, even for calls in the same clock
+ * tick or on different threads (which is exactly where srand(time(nullptr))
+ * falls over).
+ */
+inline std::uint64_t freshSeed()
+{
+    static std::atomic<std::uint64_t> counter(0);
+    std::uint64_t ticks = (std::uint64_t)std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    return mixSeed(ticks ^ mixSeed(counter.fetch_add(1, std::memory_order_relaxed)));
+}
+
+/*
+ * Seeds any engine from a 64 bit value.  Our own engines take it directly;
+ * standard engines like std::mt19937 only take a result_type.
+ */
+template<class Engine> void seedEngine(Engine& engine, std::uint64_t seedValue)
+{
+    engine.seed((typename Engine::result_type)seedValue);
+}
+
+inline void seedEngine(Pcg32& engine, std::uint64_t seedValue)
+{
+    engine.seed(seedValue);
+}
+
+/*
+ * Returns 53 uniformly random bits (exactly what a double can hold) built
+ * from two 32 bit outputs.
+ */
+template<class Engine> std::uint64_t randomBits53(Engine& engine)
+{
+    std::uint64_t bits = ((std::uint64_t)(std::uint32_t)engine() << 21) ^ (std::uint32_t)engine();
+    return bits & ((1ULL << 53) - 1);
+}
+
+/*
+ * Returns a uniformly distributed number in [0, range) using Lemire's
+ * multiply-shift method.  Unlike 'rand() % range' this isn't biased towards
+ * small numbers, and it only needs a division in the rare rejection case.
+ * The engine has to produce at least 32 uniformly random bits per call.
+ */
+template<class Engine> std::uint32_t boundedRandom(Engine& engine, std::uint32_t range)
+{
+    static_assert(Engine::min() == 0 && Engine::max() >= 0xFFFFFFFFu,
+                  "boundedRandom needs an engine with at least 32 bits of output");
+
+    std::uint64_t product = (std::uint64_t)(std::uint32_t)engine() * range;
+    std::uint32_t low = (std::uint32_t)product;
+    if (low < range)
+    {
+        //(2^32 - range) % range, the number of values that would skew the result
+        std::uint32_t threshold = (0u - range) % range;
+        while (low < threshold)
+        {
+            product = (std::uint64_t)(std::uint32_t)engine() * range;
+            low = (std::uint32_t)product;
+        }
+    }
+    return (std::uint32_t)(product >> 32);
+}
+
+/*
+ * Draws two bounded numbers, in [0, range1) and [0, range2), from a single
+ * 32 bit engine call (Brackett-Rozinsky and Lemire's batched version of the
+ * method above).  The ranges' product has to fit in 32 bits; draw(k, out)
+ * uses this to halve its engine calls on bags of up to 65536 items.
+ */
+template<class Engine> void boundedRandomPair(Engine& engine, std::uint32_t range1, std::uint32_t range2,
+                                              std::uint32_t& result1, std::uint32_t& result2)
+{
+    static_assert(Engine::min() == 0 && Engine::max() >= 0xFFFFFFFFu,
+                  "boundedRandomPair needs an engine with at least 32 bits of output");
+
+    std::uint32_t product = range1 * range2;
+    while (true)
+    {
+        std::uint64_t first = (std::uint64_t)(std::uint32_t)engine() * range1;
+        std::uint64_t second = (first & 0xFFFFFFFFu) * range2;
+        std::uint32_t low = (std::uint32_t)second;
+        //same rejection rule as above, applied to the combined range
+        if (low >= product || low >= (0u - product) % product)
+        {
+            result1 = (std::uint32_t)(first >> 32);
+            result2 = (std::uint32_t)(second >> 32);
+            return;
+        }
+    }
+}
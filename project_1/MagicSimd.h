@@ -0,0 +1,237 @@
+#pragma once
+
+//Programmer-tested
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define MAGICBAG_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+//how many values peekMany compares against each block of contents in one pass
+#define PEEK_GROUP 8
+
+/*
+ * Counting kernels behind MagicBag::peek and peekMany.
+ *
+ * The kind of kernel is picked at compile time from T: 4 byte integers and
+ * floats get SSE2/AVX2 versions (AVX2 only if the CPU we're running on has
+ * it, which is checked once), and everything else gets a plain loop that
+ * compilers can usually vectorize for other arithmetic types.  Non-x86
+ * builds always use the plain loop.
+ */
+struct ScalarCount {};
+struct Int32Count {};
+struct FloatCount {};
+
+template<class T> struct CountKernel
+{
+#ifdef MAGICBAG_X86_SIMD
+    typedef typename std::conditional<std::is_integral<T>::value && sizeof(T) == 4, Int32Count,
+            typename std::conditional<std::is_same<T, float>::value, FloatCount, ScalarCount>::type>::type type;
+#else
+    typedef ScalarCount type;
+#endif
+};
+
+template<class T> int countEqual(const T* data, int n, const T& value, ScalarCount)
+{
+    //a size_t index and an unsigned sum keep the loop vectorizable
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < (std::size_t)n; i++)
+    {
+        count += (data[i] == value);
+    }
+    return (int)count;
+}
+
+template<class T> void countEqualMany(const T* data, int n, const T* values, int valueCount, int* counts, ScalarCount)
+{
+    for (int j = 0; j < valueCount; j++) counts[j] = 0;
+    for (std::size_t i = 0; i < (std::size_t)n; i++)
+    {
+        for (int j = 0; j < valueCount; j++) counts[j] += (data[i] == values[j]);
+    }
+}
+
+#ifdef MAGICBAG_X86_SIMD
+
+inline bool cpuHasAvx2()
+{
+    static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+    return hasAvx2;
+}
+
+//comparisons give all-ones (-1) lanes on a match, so subtracting them counts
+inline int sumLanes(__m128i counts)
+{
+    std::int32_t lanes[4];
+    _mm_storeu_si128((__m128i *)lanes, counts);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+__attribute__((target("avx2"))) inline int sumLanes(__m256i counts)
+{
+    return sumLanes(_mm_add_epi32(_mm256_castsi256_si128(counts), _mm256_extracti128_si256(counts, 1)));
+}
+
+inline __m128i matchSse2(__m128i block, __m128i needle, Int32Count)
+{
+    return _mm_cmpeq_epi32(block, needle);
+}
+
+inline __m128i matchSse2(__m128i block, __m128i needle, FloatCount)
+{
+    //compare as floats (so -0.0 == 0.0 and NaN never matches), count as ints
+    return _mm_castps_si128(_mm_cmpeq_ps(_mm_castsi128_ps(block), _mm_castsi128_ps(needle)));
+}
+
+__attribute__((target("avx2"))) inline __m256i matchAvx2(__m256i block, __m256i needle, Int32Count)
+{
+    return _mm256_cmpeq_epi32(block, needle);
+}
+
+__attribute__((target("avx2"))) inline __m256i matchAvx2(__m256i block, __m256i needle, FloatCount)
+{
+    return _mm256_castps_si256(_mm256_cmp_ps(_mm256_castsi256_ps(block), _mm256_castsi256_ps(needle), _CMP_EQ_OQ));
+}
+
+template<class T> __m128i broadcastSse2(const T& value)
+{
+    std::int32_t bits;
+    __builtin_memcpy(&bits, &value, 4);
+    return _mm_set1_epi32(bits);
+}
+
+template<class T> __attribute__((target("avx2"))) __m256i broadcastAvx2(const T& value)
+{
+    std::int32_t bits;
+    __builtin_memcpy(&bits, &value, 4);
+    return _mm256_set1_epi32(bits);
+}
+
+template<class T, class Kind> int countEqualSse2(const T* data, int n, const T& value, Kind kind)
+{
+    __m128i needle = broadcastSse2(value);
+    //two accumulators so consecutive compares don't wait on each other
+    __m128i counts0 = _mm_setzero_si128();
+    __m128i counts1 = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        counts0 = _mm_sub_epi32(counts0, matchSse2(_mm_loadu_si128((const __m128i *)(data + i)), needle, kind));
+        counts1 = _mm_sub_epi32(counts1, matchSse2(_mm_loadu_si128((const __m128i *)(data + i + 4)), needle, kind));
+    }
+    int count = sumLanes(_mm_add_epi32(counts0, counts1));
+    for (; i < n; i++) count += (data[i] == value);
+    return count;
+}
+
+template<class T, class Kind> __attribute__((target("avx2"))) int countEqualAvx2(const T* data, int n, const T& value, Kind kind)
+{
+    __m256i needle = broadcastAvx2(value);
+    __m256i counts0 = _mm256_setzero_si256();
+    __m256i counts1 = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        counts0 = _mm256_sub_epi32(counts0, matchAvx2(_mm256_loadu_si256((const __m256i *)(data + i)), needle, kind));
+        counts1 = _mm256_sub_epi32(counts1, matchAvx2(_mm256_loadu_si256((const __m256i *)(data + i + 8)), needle, kind));
+    }
+    int count = sumLanes(_mm256_add_epi32(counts0, counts1));
+    for (; i < n; i++) count += (data[i] == value);
+    return count;
+}
+
+template<class T, class Kind> void countEqualManySse2(const T* data, int n, const T* values, int valueCount, int* counts, Kind kind)
+{
+    __m128i needles[PEEK_GROUP];
+    __m128i groupCounts[PEEK_GROUP];
+    for (int j = 0; j < valueCount; j++)
+    {
+        needles[j] = broadcastSse2(values[j]);
+        groupCounts[j] = _mm_setzero_si128();
+    }
+
+    //each block of contents is loaded once and checked against every value
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i *)(data + i));
+        for (int j = 0; j < valueCount; j++)
+        {
+            groupCounts[j] = _mm_sub_epi32(groupCounts[j], matchSse2(block, needles[j], kind));
+        }
+    }
+
+    for (int j = 0; j < valueCount; j++)
+    {
+        counts[j] = sumLanes(groupCounts[j]);
+        for (int k = i; k < n; k++) counts[j] += (data[k] == values[j]);
+    }
+}
+
+template<class T, class Kind> __attribute__((target("avx2")))
+void countEqualManyAvx2(const T* data, int n, const T* values, int valueCount, int* counts, Kind kind)
+{
+    __m256i needles[PEEK_GROUP];
+    __m256i groupCounts[PEEK_GROUP];
+    for (int j = 0; j < valueCount; j++)
+    {
+        needles[j] = broadcastAvx2(values[j]);
+        groupCounts[j] = _mm256_setzero_si256();
+    }
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(data + i));
+        for (int j = 0; j < valueCount; j++)
+        {
+            groupCounts[j] = _mm256_sub_epi32(groupCounts[j], matchAvx2(block, needles[j], kind));
+        }
+    }
+
+    for (int j = 0; j < valueCount; j++)
+    {
+        counts[j] = sumLanes(groupCounts[j]);
+        for (int k = i; k < n; k++) counts[j] += (data[k] == values[j]);
+    }
+}
+
+template<class T> int countEqual(const T* data, int n, const T& value, Int32Count kind)
+{
+    return cpuHasAvx2() ? countEqualAvx2(data, n, value, kind) : countEqualSse2(data, n, value, kind);
+}
+
+template<class T> int countEqual(const T* data, int n, const T& value, FloatCount kind)
+{
+    return cpuHasAvx2() ? countEqualAvx2(data, n, value, kind) : countEqualSse2(data, n, value, kind);
+}
+
+template<class T, class Kind> void countEqualMany(const T* data, int n, const T* values, int valueCount, int* counts, Kind kind)
+{
+    if (cpuHasAvx2()) countEqualManyAvx2(data, n, values, valueCount, counts, kind);
+    else countEqualManySse2(data, n, values, valueCount, counts, kind);
+}
+
+#endif
+
+//counts how many of the n items in data equal value
+template<class T> int countEqual(const T* data, int n, const T& value)
+{
+    return countEqual(data, n, value, typename CountKernel<T>::type());
+}
+
+//counts several values in as few passes over data as possible
+template<class T> void countEqualMany(const T* data, int n, const T* values, int valueCount, int* counts)
+{
+    for (int j = 0; j < valueCount; j += PEEK_GROUP)
+    {
+        int group = (valueCount - j < PEEK_GROUP) ? valueCount - j : PEEK_GROUP;
+        countEqualMany(data, n, values + j, group, counts + j, typename CountKernel<T>::type());
+    }
+}
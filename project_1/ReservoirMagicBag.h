@@ -0,0 +1,234 @@
+#pragma once
+
+//Programmer-tested
+
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "MagicRandom.h"
+#include "MagicSimd.h"
+
+/*
+ * Returns a uniformly distributed number in (0, 1) with 53 random bits.
+ * Zero is left out so it's always safe to take the log.
+ */
+template<class Engine> double openUnitRandom(Engine& engine)
+{
+    return ((double)randomBits53(engine) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+/*
+ * A MagicBag for streams that are too long to keep: it never holds more
+ * than 'capacity' items, but every item it holds is a uniform sample of
+ * everything inserted so far (reservoir sampling), so draw() is still
+ * uniform over the whole stream.
+ *
+ * Inserts use Li's Algorithm L.  Once the bag is full it works out how many
+ * of the following items to skip before the next one gets in, so it only
+ * needs random numbers for the items it keeps: O(k(1 + log(n/k))) of them
+ * over n inserts instead of one per insert.  Skipped items are never copied.
+ *
+ * draw() removes the item from the sample, which shrinks it for good: a
+ * sample of k items out of a long stream can only ever hand out k of them.
+ * Once it has been drawn empty, the next insert starts a new stream.
+ */
+template<class T, class Engine = Pcg32> class ReservoirMagicBag
+{
+public:
+
+    explicit ReservoirMagicBag(int capacity) : capacity(capacity)
+    {
+        if (capacity <= 0) throw "Capacity must be positive";
+
+        //give the PRNG its own stream
+        seed(freshSeed());
+        items.reserve(capacity);
+    }
+
+    ReservoirMagicBag(int capacity, std::uint64_t seedValue) : capacity(capacity)
+    {
+        if (capacity <= 0) throw "Capacity must be positive";
+
+        //explicitly seeded bags keep the same sample every run
+        seed(seedValue);
+        items.reserve(capacity);
+    }
+
+    ReservoirMagicBag(const ReservoirMagicBag& other)
+        : items(other.items), capacity(other.capacity), seen(other.seen), threshold(other.threshold),
+          skip(other.skip), armed(other.armed)
+    {
+        //a copy gets its own stream instead of replaying the original's choices
+        seed(freshSeed());
+        items.reserve(capacity);
+    }
+
+    ReservoirMagicBag(ReservoirMagicBag&& other) noexcept
+        : items(std::move(other.items)), capacity(other.capacity), engine(other.engine), seen(other.seen),
+          threshold(other.threshold), skip(other.skip), armed(other.armed)
+    {
+        //leave the other bag empty (but still usable) with a stream of its own
+        other.items.clear();
+        other.seen = 0;
+        other.armed = false;
+        other.seed(freshSeed());
+    }
+
+    ReservoirMagicBag& operator=(ReservoirMagicBag other)
+    {
+        //copy-and-swap (or move-and-swap, since other is taken by value)
+        items.swap(other.items);
+        std::swap(capacity, other.capacity);
+        std::swap(engine, other.engine);
+        std::swap(seen, other.seen);
+        std::swap(threshold, other.threshold);
+        std::swap(skip, other.skip);
+        std::swap(armed, other.armed);
+
+        return *this;
+    }
+
+    void seed(std::uint64_t seedValue)
+    {
+        seedEngine(engine, seedValue);
+    }
+
+    void insert(const T& item)
+    {
+        offer(item);
+    }
+
+    void insert(T&& item)
+    {
+        offer(std::move(item));
+    }
+
+    T draw()
+    {
+        if (items.empty()) throw "Empty array";
+
+        //choose a random item and fill its hole with the last one, like MagicBag
+        int index = (int)boundedRandom(engine, (std::uint32_t)items.size());
+        T item(std::move(items[index]));
+        if (index != (int)items.size() - 1) items[index] = std::move(items.back());
+        items.pop_back();
+
+        //the drawn item leaves the stream too, and the smaller sample needs a new threshold
+        seen--;
+        armed = false;
+        if (items.empty()) seen = 0;
+
+        return item;
+    }
+
+    int peek(const T& item) const
+    {
+        //ints and floats get a SIMD scan, everything else a plain loop
+        return countEqual(items.data(), (int)items.size(), item);
+    }
+
+    int getSize() const
+    {
+        return (int)items.size();
+    }
+
+    int getCapacity() const
+    {
+        return capacity;
+    }
+
+    //how many items the current sample was taken from
+    std::uint64_t streamSize() const
+    {
+        return seen;
+    }
+
+    void print(std::ostream& os) const
+    {
+        os << *this;
+    }
+
+private:
+
+    std::vector<T> items;
+    int capacity;
+    Engine engine;
+
+    std::uint64_t seen = 0;    //items inserted (less those drawn) since the stream started
+    double threshold = 0;      //Algorithm L's W
+    std::uint64_t skip = 0;    //items to pass over before the next one gets in
+    bool armed = false;        //threshold and skip are up to date
+
+    template<class U> void offer(U&& item)
+    {
+        //everything so far still fits, so just keep it
+        if (seen == items.size() && (int)items.size() < capacity)
+        {
+            items.push_back(std::forward<U>(item));
+            seen++;
+            return;
+        }
+
+        if (!armed) arm();
+        seen++;
+        if (skip > 0)
+        {
+            skip--;
+            return;
+        }
+
+        //this one gets in, in place of a random one
+        int sampleSize = (int)items.size();
+        items[boundedRandom(engine, (std::uint32_t)sampleSize)] = std::forward<U>(item);
+        threshold *= std::exp(std::log(openUnitRandom(engine)) / sampleSize);
+        nextSkip();
+    }
+
+    void arm()
+    {
+        /*
+         * Think of every item as having a uniform random key, with the sample
+         * being the items with the smallest keys.  W is the largest key in
+         * the sample: the m-th smallest of n uniform keys, which is
+         * Beta(m, n - m + 1) distributed.  When the bag has just filled up
+         * (m == n) that's simply U^(1/m).  After a draw it has to be rebuilt
+         * from scratch, from two gamma variates.
+         */
+        double sampleSize = (double)items.size();
+        if (seen == items.size())
+        {
+            threshold = std::exp(std::log(openUnitRandom(engine)) / sampleSize);
+        }
+        else
+        {
+            std::gamma_distribution<double> kept(sampleSize, 1.0);
+            std::gamma_distribution<double> passed((double)(seen - items.size()) + 1.0, 1.0);
+            double x = kept(engine);
+            threshold = x / (x + passed(engine));
+        }
+        nextSkip();
+        armed = true;
+    }
+
+    void nextSkip()
+    {
+        //each item gets in with probability W, so the gap before the next one is geometric
+        double gap = std::floor(std::log(openUnitRandom(engine)) / std::log1p(-threshold));
+        skip = (gap < 1.8e19) ? (std::uint64_t)gap : UINT64_MAX;
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, const ReservoirMagicBag& rmb)
+    {
+        os << "{";
+        for (int i = 0; i < (int)rmb.items.size(); i++)
+        {
+            if (i > 0) os << ", ";
+            os << rmb.items[i];
+        }
+        return os << "}";
+    }
+};
@@ -0,0 +1,487 @@
+#pragma once
+
+//Programmer-tested
+
+#include <cstdint>
+#include <iostream>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "MagicBag.h"
+#include "MagicRandom.h"
+
+/*
+ * Returns a uniformly distributed weight in [0, total).
+ * Floating point weights get 53 random bits; integer weights use 64 bit
+ * rejection sampling so big totals aren't biased.
+ */
+template<class Engine> double randomWeightBelow(Engine& engine, double total, std::true_type /*floating point*/)
+{
+    return (double)randomBits53(engine) * (1.0 / 9007199254740992.0) * total;
+}
+
+template<class Engine, class Weight> Weight randomWeightBelow(Engine& engine, Weight total, std::false_type /*floating point*/)
+{
+    std::uint64_t range = (std::uint64_t)total;
+    //2^64 % range, the number of values that would skew the result
+    std::uint64_t threshold = (0 - range) % range;
+    while (true)
+    {
+        std::uint64_t bits = ((std::uint64_t)(std::uint32_t)engine() << 32) | (std::uint32_t)engine();
+        if (bits >= threshold) return (Weight)(bits % range);
+    }
+}
+
+/*
+ * Remembers which slots of a WeightedMagicBag hold each distinct item, so
+ * remove(item) doesn't have to search.  positions[slot] is where that slot
+ * sits in its item's list, which lets a slot be dropped or renumbered in O(1).
+ */
+template<class T, class Hash> class BagSlots
+{
+public:
+
+    static const bool enabled = true;
+
+    //records that item was appended at slot (which is always the last one)
+    void add(const T& item, int slot)
+    {
+        std::vector<int>& list = slots[item];
+        positions.push_back((int)list.size());
+        try
+        {
+            list.push_back(slot);
+        }
+        catch (...)
+        {
+            positions.pop_back();
+            if (list.empty()) slots.erase(item);
+            throw;
+        }
+    }
+
+    //forgets that item is at slot
+    void remove(const T& item, int slot)
+    {
+        typename std::unordered_map<T, std::vector<int>, Hash>::iterator entry = slots.find(item);
+        std::vector<int>& list = entry->second;
+        int moved = list.back();
+        list[positions[slot]] = moved;
+        positions[moved] = positions[slot];
+        list.pop_back();
+        if (list.empty()) slots.erase(entry);
+    }
+
+    //item has been moved from one slot to another
+    void renumber(const T& item, int from, int to)
+    {
+        slots.find(item)->second[positions[from]] = to;
+        positions[to] = positions[from];
+    }
+
+    //the last slot is gone
+    void shrink()
+    {
+        positions.pop_back();
+    }
+
+    //some slot holding item, or -1
+    int find(const T& item) const
+    {
+        typename std::unordered_map<T, std::vector<int>, Hash>::const_iterator entry = slots.find(item);
+        return (entry == slots.end()) ? -1 : entry->second.back();
+    }
+
+    int count(const T& item) const
+    {
+        typename std::unordered_map<T, std::vector<int>, Hash>::const_iterator entry = slots.find(item);
+        return (entry == slots.end()) ? 0 : (int)entry->second.size();
+    }
+
+    void clear()
+    {
+        slots.clear();
+        positions.clear();
+    }
+
+    void swap(BagSlots& other)
+    {
+        slots.swap(other.slots);
+        positions.swap(other.positions);
+    }
+
+private:
+
+    std::unordered_map<T, std::vector<int>, Hash> slots;
+    std::vector<int> positions;
+};
+
+template<class T> class BagSlots<T, NoCounting>
+{
+public:
+
+    static const bool enabled = false;
+
+    void add(const T&, int) {}
+    void remove(const T&, int) {}
+    void renumber(const T&, int, int) {}
+    void shrink() {}
+    int find(const T&) const { return -1; }
+    int count(const T&) const { return 0; }
+    void clear() {}
+    void swap(BagSlots&) {}
+};
+
+/*
+ * A MagicBag where each item is drawn with probability proportional to its
+ * weight.  The weights live in a Fenwick (binary indexed) tree, so insert
+ * and draw are O(log n) instead of inserting duplicate copies.
+ * Passing a hasher keeps an index from items to the slots holding them, which
+ * makes remove(item) O(log n) and peek() O(1); without one, both search the
+ * whole bag.
+ *
+ * A bag that stops changing can be frozen: that builds a Walker/Vose alias
+ * table, after which sample() is O(1).  draw() removes what it picks, so it
+ * isn't available while frozen; frozen bags can only be sampled (with
+ * replacement) until they're thawed.
+ *
+ * Integer weights are exact.  Floating point weights can drift slightly
+ * after many removals, so items are picked with very nearly (but not
+ * exactly) their weight's share.
+ */
+template<class T, class Weight = double, class Engine = Pcg32, class Hash = NoCounting> class WeightedMagicBag
+{
+    static_assert(std::is_arithmetic<Weight>::value, "weights have to be numbers");
+
+public:
+
+    WeightedMagicBag()
+    {
+        seed(freshSeed());
+        //the Fenwick tree is 1-indexed; slot 0 is never used
+        fenwick.push_back(0);
+    }
+
+    explicit WeightedMagicBag(std::uint64_t seedValue)
+    {
+        seed(seedValue);
+        fenwick.push_back(0);
+    }
+
+    WeightedMagicBag(const WeightedMagicBag& other)
+        : items(other.items), weights(other.weights), fenwick(other.fenwick), slots(other.slots),
+          frozen(other.frozen), threshold(other.threshold), alias(other.alias)
+    {
+        //a copy gets its own stream instead of replaying the original's draws
+        seed(freshSeed());
+    }
+
+    WeightedMagicBag(WeightedMagicBag&& other) noexcept
+        : items(std::move(other.items)), weights(std::move(other.weights)), fenwick(std::move(other.fenwick)),
+          engine(other.engine), slots(std::move(other.slots)), frozen(other.frozen),
+          threshold(std::move(other.threshold)), alias(std::move(other.alias))
+    {
+        //leave the other bag empty (but still usable, its Fenwick tree gets slot 0 back on insert)
+        other.items.clear();
+        other.weights.clear();
+        other.fenwick.clear();
+        other.slots.clear();
+        other.thaw();
+        other.seed(freshSeed());
+    }
+
+    WeightedMagicBag& operator=(WeightedMagicBag other)
+    {
+        //copy-and-swap (or move-and-swap, since other is taken by value)
+        items.swap(other.items);
+        weights.swap(other.weights);
+        fenwick.swap(other.fenwick);
+        std::swap(engine, other.engine);
+        slots.swap(other.slots);
+        std::swap(frozen, other.frozen);
+        threshold.swap(other.threshold);
+        alias.swap(other.alias);
+
+        return *this;
+    }
+
+    void seed(std::uint64_t seedValue)
+    {
+        seedEngine(engine, seedValue);
+    }
+
+    void insert(T item, Weight weight = 1)
+    {
+        if (frozen) throw "Frozen bag";
+        if (weight < 0) throw "Negative weight";
+        if (fenwick.empty()) fenwick.push_back(0);
+
+        int slot = (int)items.size();
+        slots.add(item, slot);
+        try
+        {
+            items.push_back(std::move(item));
+            weights.push_back(weight);
+
+            /*
+             * A Fenwick node i holds the sum of the weights in (i - lowbit(i), i].
+             * Everything before i is already in the tree, so two prefix sums give
+             * us the rest of that range.
+             */
+            int i = slot + 1;
+            fenwick.push_back(weight + prefixSum(i - 1) - prefixSum(i - (i & -i)));
+        }
+        catch (...)
+        {
+            //out of memory partway: put back whatever already went in
+            slots.remove(((int)items.size() > slot) ? items.back() : item, slot);
+            slots.shrink();
+            if ((int)items.size() > slot) items.pop_back();
+            if ((int)weights.size() > slot) weights.pop_back();
+            throw;
+        }
+    }
+
+    T draw()
+    {
+        if (frozen) throw "Frozen bag";
+        if (items.empty()) throw "Empty array";
+        if (totalWeight() <= 0) throw "No weight";
+
+        int index = find(randomWeightBelow(engine, totalWeight(), std::is_floating_point<Weight>()));
+        T item = removeAt(index);
+
+        return item;
+    }
+
+    //removes one copy of item (without a hasher it has to be found first, which is O(n))
+    bool remove(const T& item)
+    {
+        if (frozen) throw "Frozen bag";
+
+        if (BagSlots<T, Hash>::enabled)
+        {
+            int slot = slots.find(item);
+            if (slot < 0) return false;
+            removeAt(slot);
+            return true;
+        }
+
+        for (int i = 0; i < (int)items.size(); i++)
+        {
+            if (items[i] == item)
+            {
+                removeAt(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //picks an item by weight without removing it
+    const T& sample()
+    {
+        if (items.empty()) throw "Empty array";
+
+        if (frozen)
+        {
+            //freeze() leaves the table empty when there's no weight to pick by
+            if (threshold.empty()) throw "No weight";
+
+            //roll a fair die for the column, then a biased coin for the column or its alias
+            int column = (int)boundedRandom(engine, (std::uint32_t)items.size());
+            double coin = (double)(std::uint32_t)engine() * (1.0 / 4294967296.0);
+            return items[(coin < threshold[column]) ? column : alias[column]];
+        }
+
+        if (totalWeight() <= 0) throw "No weight";
+        return items[find(randomWeightBelow(engine, totalWeight(), std::is_floating_point<Weight>()))];
+    }
+
+    int peek(const T& item) const
+    {
+        if (BagSlots<T, Hash>::enabled) return slots.count(item);
+
+        int count = 0;
+
+        for (int i = 0; i < (int)items.size(); i++)
+        {
+            if (items[i] == item) count++;
+        }
+
+        return count;
+    }
+
+    int getSize() const
+    {
+        return (int)items.size();
+    }
+
+    Weight totalWeight() const
+    {
+        return prefixSum((int)items.size());
+    }
+
+    void freeze()
+    {
+        /*
+         * Vose's version of Walker's alias method.  Each of the n columns
+         * holds exactly 1/n of the total probability: some of its own item's
+         * share (threshold) and the rest borrowed from one heavier item (alias).
+         */
+        int n = (int)items.size();
+        threshold.clear();
+        alias.clear();
+        if (n == 0 || totalWeight() <= 0)
+        {
+            frozen = true;
+            return;
+        }
+        threshold.assign(n, 1.0);
+        alias.assign(n, 0);
+
+        std::vector<double> scaled(n);
+        std::vector<int> small, large;
+        double scale = (double)n / (double)totalWeight();
+        for (int i = 0; i < n; i++)
+        {
+            scaled[i] = (double)weights[i] * scale;
+            if (scaled[i] < 1.0) small.push_back(i);
+            else large.push_back(i);
+        }
+
+        while (!small.empty() && !large.empty())
+        {
+            int lighter = small.back();
+            small.pop_back();
+            int heavier = large.back();
+
+            //top up the lighter column with some of the heavier item
+            threshold[lighter] = scaled[lighter];
+            alias[lighter] = heavier;
+            scaled[heavier] -= 1.0 - scaled[lighter];
+            if (scaled[heavier] < 1.0)
+            {
+                large.pop_back();
+                small.push_back(heavier);
+            }
+        }
+        //whatever is left is 1.0 up to rounding error
+        for (int i : small) threshold[i] = 1.0;
+        for (int i : large) threshold[i] = 1.0;
+
+        frozen = true;
+    }
+
+    void thaw()
+    {
+        frozen = false;
+        threshold.clear();
+        alias.clear();
+    }
+
+    bool isFrozen() const
+    {
+        return frozen;
+    }
+
+    void print(std::ostream& os) const
+    {
+        os << *this;
+    }
+
+private:
+
+    std::vector<T> items;
+    std::vector<Weight> weights;
+    std::vector<Weight> fenwick;
+    Engine engine;
+    BagSlots<T, Hash> slots;
+
+    bool frozen = false;
+    std::vector<double> threshold;
+    std::vector<int> alias;
+
+    //sum of the first count weights
+    Weight prefixSum(int count) const
+    {
+        Weight sum = 0;
+        for (int i = count; i > 0; i -= i & -i) sum += fenwick[i];
+        return sum;
+    }
+
+    void addWeight(int index, Weight delta)
+    {
+        for (int i = index + 1; i < (int)fenwick.size(); i += i & -i) fenwick[i] += delta;
+    }
+
+    //finds the item whose share of the total covers target
+    int find(Weight target) const
+    {
+        /*
+         * Walk down the implicit tree from the biggest power of two, skipping
+         * every block whose whole weight fits under what's left of target.
+         */
+        int n = (int)items.size();
+        int step = 1;
+        while (step * 2 <= n) step *= 2;
+
+        int position = 0;
+        for (; step > 0; step >>= 1)
+        {
+            if (position + step <= n && fenwick[position + step] <= target)
+            {
+                position += step;
+                target -= fenwick[position];
+            }
+        }
+
+        //rounding can push a floating point target just past the end
+        return (position < n) ? position : n - 1;
+    }
+
+    T removeAt(int index)
+    {
+        //unindex the item while it's still there to look up, then take it out
+        int last = (int)items.size() - 1;
+        slots.remove(items[index], index);
+        T item(std::move(items[index]));
+
+        //same trick as MagicBag: move the last item into the hole
+        if (index != last)
+        {
+            slots.renumber(items[last], last, index);
+            addWeight(index, weights[last] - weights[index]);
+            items[index] = std::move(items[last]);
+            weights[index] = weights[last];
+        }
+
+        //nothing else in a Fenwick tree covers the last slot, so it can just go
+        items.pop_back();
+        weights.pop_back();
+        fenwick.pop_back();
+        slots.shrink();
+
+        return item;
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, const WeightedMagicBag& wmb)
+    {
+        os << "{";
+        for (int i = 0; i < (int)wmb.items.size(); i++)
+        {
+            if (i > 0) os << ", ";
+            os << wmb.items[i] << ": " << wmb.weights[i];
+        }
+        return os << "}";
+    }
+};
+
+/*
+ * A WeightedMagicBag that keeps an index from items to their slots, so
+ * remove(item) is O(log n) and peek() is a hash lookup instead of a scan.
+ */
+template<class T, class Weight = double, class Hash = std::hash<T>, class Engine = Pcg32>
+using IndexedWeightedMagicBag = WeightedMagicBag<T, Weight, Engine, Hash>;
@@ -0,0 +1,477 @@
+// Measures MagicBag insert/draw/peek/copy throughput for int, std::string and
+// a 256-byte struct at several sizes, with the allocations and bytes copied
+// behind each operation, next to the usual std::vector + std::shuffle way of
+// doing the same thing.  Then checks how ConcurrentMagicBag draws scale with
+// threads against one MagicBag behind one mutex.
+//
+// Allocations are counted by wrapping malloc/realloc/free (glibc), so they
+// include MagicBag's own raw storage as well as everything new'd; elsewhere
+// only operator new is seen.  Bytes copied come from a second, instrumented
+// run in which every element copy and move is counted (a string copy counts
+// its heap characters too).  The instrumented elements aren't trivially
+// copyable, so that run relocates element by element where MagicBag would
+// realloc a plain int array; for int and Blob256 the relocation bytes are an
+// upper bound.
+//
+// Build: cmake -S . -B build && cmake --build build   (or
+//        g++ -O2 -std=c++11 -pthread bench_magicbag.cpp -o bench_magicbag)
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "ConcurrentMagicBag.h"
+#include "MagicBag.h"
+
+using namespace std;
+
+// ---------------------------------------------------------------------------
+// allocation and copy accounting
+
+static atomic<long long> allocations(0);
+static atomic<long long> copiedBytes(0);
+
+#ifdef __GLIBC__
+extern "C"
+{
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+void __libc_free(void *pointer);
+
+void *malloc(size_t size) noexcept
+{
+	allocations.fetch_add(1, memory_order_relaxed);
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) noexcept
+{
+	allocations.fetch_add(1, memory_order_relaxed);
+	return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size) noexcept
+{
+	// growing in place doesn't count as a new allocation
+	void *result = __libc_realloc(pointer, size);
+	if (result != pointer)
+	{
+		allocations.fetch_add(1, memory_order_relaxed);
+	}
+	return result;
+}
+
+void free(void *pointer) noexcept
+{
+	__libc_free(pointer);
+}
+}
+#else
+void *operator new(size_t size)
+{
+	allocations.fetch_add(1, memory_order_relaxed);
+	void *memory = malloc(size);
+	if (memory == nullptr) throw bad_alloc();
+	return memory;
+}
+
+void operator delete(void *pointer) noexcept
+{
+	free(pointer);
+}
+#endif
+
+struct Counters
+{
+	long long allocations;
+	long long copiedBytes;
+
+	static Counters now()
+	{
+		Counters counters = {::allocations.load(), ::copiedBytes.load()};
+		return counters;
+	}
+};
+
+// ---------------------------------------------------------------------------
+// element types
+
+struct Blob256
+{
+	unsigned char bytes[256];
+
+	bool operator==(const Blob256& other) const
+	{
+		return memcmp(bytes, other.bytes, sizeof(bytes)) == 0;
+	}
+};
+
+static void makeItem(int i, int& item)
+{
+	item = i;
+}
+
+static void makeItem(int i, string& item)
+{
+	// long enough to live on the heap, so copying one really costs something
+	item = "item-" + to_string(i) + "-padding-past-sso";
+}
+
+static void makeItem(int i, Blob256& item)
+{
+	memset(item.bytes, 0, sizeof(item.bytes));
+	memcpy(item.bytes, &i, sizeof(i));
+}
+
+static long long payloadBytes(const int&) { return 0; }
+static long long payloadBytes(const string& item) { return (item.size() > 15) ? (long long)item.size() : 0; }
+static long long payloadBytes(const Blob256&) { return 0; }
+
+// counts every copy and move of the wrapped item in copiedBytes; moves are
+// noexcept whenever T's are, so containers move a Tracked<T> exactly as they would a T
+template<class T> struct Tracked
+{
+	T item;
+
+	Tracked() {}
+	Tracked(const Tracked& other) : item(other.item) { copied(sizeof(T) + payloadBytes(item)); }
+	Tracked(Tracked&& other) noexcept(std::is_nothrow_move_constructible<T>::value)
+		: item(std::move(other.item)) { copied(sizeof(T)); }
+
+	Tracked& operator=(const Tracked& other)
+	{
+		item = other.item;
+		copied(sizeof(T) + payloadBytes(item));
+		return *this;
+	}
+
+	Tracked& operator=(Tracked&& other) noexcept(std::is_nothrow_move_assignable<T>::value)
+	{
+		item = std::move(other.item);
+		copied(sizeof(T));
+		return *this;
+	}
+
+	bool operator==(const Tracked& other) const { return item == other.item; }
+
+	static void copied(long long bytes) { copiedBytes.fetch_add(bytes, memory_order_relaxed); }
+};
+
+template<class T> static void makeItem(int i, Tracked<T>& tracked)
+{
+	makeItem(i, tracked.item);
+}
+
+template<class T> static long long payloadBytes(const Tracked<T>& tracked)
+{
+	return payloadBytes(tracked.item);
+}
+
+// ---------------------------------------------------------------------------
+// the operations, on MagicBag and on vector + shuffle
+
+enum Operation { INSERT, DRAW, DRAW_K, PEEK, COPY };
+
+static const char *operationNames[] = {"insert", "draw", "draw(k)", "peek", "copy"};
+
+static long long checksum = 0;
+
+template<class T> static vector<T> makeItems(int n)
+{
+	vector<T> items(n);
+	for (int i = 0; i < n; i++) makeItem(i % (n / 4 + 1), items[i]);
+	return items;
+}
+
+// times the operation over 'reps' fresh bags; returns the total nanoseconds
+template<class T> static double runMagicBag(Operation op, const vector<T>& items, int reps)
+{
+	int n = (int)items.size();
+	double nanos = 0;
+	for (int rep = 0; rep < reps; rep++)
+	{
+		MagicBag<T> bag;
+		if (op != INSERT)
+		{
+			for (int i = 0; i < n; i++) bag.insert(items[i]);
+		}
+		vector<T> out;
+		if (op == DRAW_K) out.reserve(n);
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		switch (op)
+		{
+		case INSERT:
+			for (int i = 0; i < n; i++) bag.insert(items[i]);
+			break;
+		case DRAW:
+			for (int i = 0; i < n; i++) checksum += payloadBytes(bag.draw());
+			break;
+		case DRAW_K:
+			bag.draw(n, back_inserter(out));
+			break;
+		case PEEK:
+			for (int i = 0; i < 16; i++) checksum += bag.peek(items[(i * 7919) % n]);
+			break;
+		case COPY:
+		{
+			MagicBag<T> copy(bag);
+			checksum += copy.getSize();
+			break;
+		}
+		}
+		nanos += chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+	}
+	return nanos;
+}
+
+template<class T> static double runVector(Operation op, const vector<T>& items, int reps)
+{
+	int n = (int)items.size();
+	double nanos = 0;
+	Pcg32 engine(12345);
+	for (int rep = 0; rep < reps; rep++)
+	{
+		vector<T> bag;
+		if (op != INSERT) bag.assign(items.begin(), items.end());
+		vector<T> out;
+		if (op == DRAW_K) out.reserve(n);
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		switch (op)
+		{
+		case INSERT:
+			for (int i = 0; i < n; i++) bag.push_back(items[i]);
+			break;
+		case DRAW:
+			// the usual way: shuffle once, then deal from the back
+			shuffle(bag.begin(), bag.end(), engine);
+			for (int i = 0; i < n; i++)
+			{
+				T item(std::move(bag.back()));
+				bag.pop_back();
+				checksum += payloadBytes(item);
+			}
+			break;
+		case DRAW_K:
+			shuffle(bag.begin(), bag.end(), engine);
+			move(bag.end() - n, bag.end(), back_inserter(out));
+			bag.resize(bag.size() - n);
+			break;
+		case PEEK:
+			for (int i = 0; i < 16; i++) checksum += count(bag.begin(), bag.end(), items[(i * 7919) % n]);
+			break;
+		case COPY:
+		{
+			vector<T> copy(bag);
+			checksum += (long long)copy.size();
+			break;
+		}
+		}
+		nanos += chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+	}
+	return nanos;
+}
+
+// allocations and bytes copied for the timed part only, measured around a single repetition
+template<class T, class Run> static void account(Run run, Operation op, const vector<T>& items,
+                                                 double& allocsPerOp, double& bytesPerOp)
+{
+	// everything the setup allocates is counted too, so take it away again
+	Counters before = Counters::now();
+	run(op, items, 1, true);
+	Counters setup = Counters::now();
+	run(op, items, 1, false);
+	Counters after = Counters::now();
+
+	int ops = (op == PEEK) ? 16 : (op == COPY || op == DRAW_K) ? 1 : (int)items.size();
+	long long allocs = (after.allocations - setup.allocations) - (setup.allocations - before.allocations);
+	long long bytes = (after.copiedBytes - setup.copiedBytes) - (setup.copiedBytes - before.copiedBytes);
+	allocsPerOp = (double)max(allocs, 0LL) / ops;
+	bytesPerOp = (double)max(bytes, 0LL) / ops;
+}
+
+// the same run with the operation itself left out, to cancel the setup out of the counters
+template<class T> struct MagicBagRun
+{
+	void operator()(Operation op, const vector<T>& items, int reps, bool setupOnly) const
+	{
+		if (setupOnly)
+		{
+			for (int rep = 0; rep < reps; rep++)
+			{
+				MagicBag<T> bag;
+				if (op != INSERT)
+				{
+					for (int i = 0; i < (int)items.size(); i++) bag.insert(items[i]);
+				}
+				vector<T> out;
+				if (op == DRAW_K) out.reserve(items.size());
+			}
+		}
+		else
+		{
+			runMagicBag(op, items, reps);
+		}
+	}
+};
+
+template<class T> struct VectorRun
+{
+	void operator()(Operation op, const vector<T>& items, int reps, bool setupOnly) const
+	{
+		if (setupOnly)
+		{
+			for (int rep = 0; rep < reps; rep++)
+			{
+				vector<T> bag;
+				if (op != INSERT) bag.assign(items.begin(), items.end());
+				vector<T> out;
+				if (op == DRAW_K) out.reserve(items.size());
+			}
+		}
+		else
+		{
+			runVector(op, items, reps);
+		}
+	}
+};
+
+template<class T> static void benchType(const char *typeName, const vector<int>& sizes)
+{
+	printf("\n%s (%d bytes)\n", typeName, (int)sizeof(T));
+	printf("%9s %-8s | %10s %9s %10s | %10s %9s %10s\n", "n", "op",
+	       "bag ns/op", "allocs/op", "copied B/op", "vec ns/op", "allocs/op", "copied B/op");
+
+	for (int n : sizes)
+	{
+		vector<T> items = makeItems<T>(n);
+		vector<Tracked<T> > trackedItems = makeItems<Tracked<T> >(n);
+		// about 10M element operations per row, at least one repetition
+		int reps = max(1, 10000000 / n);
+
+		for (int op = INSERT; op <= COPY; op++)
+		{
+			Operation operation = (Operation)op;
+			int ops = (operation == PEEK) ? 16 : (operation == COPY || operation == DRAW_K) ? 1 : n;
+			int opReps = (operation == PEEK) ? max(1, reps / 50) : reps;
+
+			double bagNanos = runMagicBag(operation, items, opReps) / opReps / ops;
+			double vecNanos = runVector(operation, items, opReps) / opReps / ops;
+
+			// allocations come from the real types, copies from the instrumented ones
+			double bagAllocs, vecAllocs, bagCopied, vecCopied, unused;
+			account(MagicBagRun<T>(), operation, items, bagAllocs, unused);
+			account(VectorRun<T>(), operation, items, vecAllocs, unused);
+			account(MagicBagRun<Tracked<T> >(), operation, trackedItems, unused, bagCopied);
+			account(VectorRun<Tracked<T> >(), operation, trackedItems, unused, vecCopied);
+
+			printf("%9d %-8s | %10.1f %9.3f %10.1f | %10.1f %9.3f %10.1f\n", n, operationNames[op],
+			       bagNanos, bagAllocs, bagCopied, vecNanos, vecAllocs, vecCopied);
+		}
+	}
+}
+
+// ---------------------------------------------------------------------------
+// multi-thread draws
+
+template<class Bag, class Insert, class Draw> static double drawsPerSecond(int threadCount, int items,
+                                                                           Bag& bag, Insert insert, Draw draw)
+{
+	// every thread fills its own share first, then they all draw until the bag is empty
+	vector<thread> threads;
+	for (int t = 0; t < threadCount; t++)
+	{
+		threads.push_back(thread([&, t]() {
+			for (int i = t; i < items; i += threadCount) insert(bag, i);
+		}));
+	}
+	for (thread& worker : threads) worker.join();
+	threads.clear();
+
+	atomic<long long> drawn(0);
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for (int t = 0; t < threadCount; t++)
+	{
+		threads.push_back(thread([&]() {
+			long long mine = 0;
+			int item;
+			while (draw(bag, item)) mine++;
+			drawn += mine;
+		}));
+	}
+	for (thread& worker : threads) worker.join();
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	if (drawn != items) printf("  (drew %lld of %d items!)\n", drawn.load(), items);
+	return (double)drawn / seconds;
+}
+
+struct LockedBag
+{
+	mutex lock;
+	MagicBag<int> bag;
+};
+
+static void benchThreads()
+{
+	const int items = 4000000;
+	unsigned int cores = thread::hardware_concurrency();
+	printf("\nConcurrentMagicBag<int> draws, %d items, %u hardware threads\n", items, cores);
+	printf("%8s | %14s %14s\n", "threads", "sharded M/s", "one lock M/s");
+
+	for (int threadCount = 1; threadCount <= (int)max(cores, 8u); threadCount *= 2)
+	{
+		ConcurrentMagicBag<int> sharded;
+		double shardedRate = drawsPerSecond(threadCount, items, sharded,
+			[](ConcurrentMagicBag<int>& bag, int i) { bag.insert(i); },
+			[](ConcurrentMagicBag<int>& bag, int& item) { return bag.tryDraw(item); });
+
+		LockedBag locked;
+		double lockedRate = drawsPerSecond(threadCount, items, locked,
+			[](LockedBag& bag, int i) { lock_guard<mutex> guard(bag.lock); bag.bag.insert(i); },
+			[](LockedBag& bag, int& item) {
+				lock_guard<mutex> guard(bag.lock);
+				if (bag.bag.getSize() == 0) return false;
+				item = bag.bag.draw();
+				return true;
+			});
+
+		printf("%8d | %14.1f %14.1f\n", threadCount, shardedRate / 1e6, lockedRate / 1e6);
+	}
+}
+
+int main()
+{
+#ifndef __GLIBC__
+	printf("note: not glibc, so raw malloc calls (MagicBag's own storage) aren't counted\n");
+#endif
+	printf("ns/op and allocs/op are per item for insert/draw, per scan for peek, and per call for draw(k)/copy.\n");
+	printf("copied B/op counts every element copy or move (and string contents).\n");
+
+	vector<int> sizes;
+	sizes.push_back(1000);
+	sizes.push_back(100000);
+	sizes.push_back(1000000);
+	benchType<int>("int", sizes);
+	benchType<string>("std::string", sizes);
+	// a million 256-byte items (times the copies) is more memory than this needs
+	sizes.pop_back();
+	benchType<Blob256>("Blob256", sizes);
+
+	benchThreads();
+
+	printf("\n(checksum %lld)\n", checksum);
+	return 0;
+}
@@ -0,0 +1,62 @@
+// Compares peek() on a plain MagicBag (linear scan) against a CountingMagicBag
+// (hash-based multiplicity index) across bag sizes and duplicate ratios.
+//
+// Build: g++ -O2 -std=c++11 bench_peek.cpp -o bench_peek
+
+#include <chrono>
+#include <cstdio>
+
+#include "MagicBag.h"
+
+using namespace std;
+
+template<class Bag> double nanosPerPeek(const Bag& bag, int distinct, int peeks, long long& checksum)
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for (int i = 0; i < peeks; i++)
+	{
+		checksum += bag.peek(i % distinct);
+	}
+	chrono::steady_clock::time_point end = chrono::steady_clock::now();
+	return chrono::duration<double, nano>(end - start).count() / peeks;
+}
+
+int main() {
+
+	const int sizes[] = {1000, 10000, 100000, 1000000};
+	// fraction of the items that are distinct values (1.0 = no duplicates)
+	const double distinctRatios[] = {1.0, 0.1, 0.001};
+
+	long long checksum = 0;
+	printf("%10s %10s %14s %14s %10s\n", "size", "distinct", "scan ns/peek", "hash ns/peek", "speedup");
+
+	for (int size : sizes)
+	{
+		for (double ratio : distinctRatios)
+		{
+			int distinct = (int)(size * ratio);
+			if (distinct < 1) distinct = 1;
+
+			MagicBag<int> plain(size, 1);
+			CountingMagicBag<int> counting;
+			counting.seed(1);
+			for (int i = 0; i < size; i++)
+			{
+				plain.insert(i % distinct);
+				counting.insert(i % distinct);
+			}
+
+			// keep the scan's total work roughly constant across sizes
+			int peeks = 20000000 / size;
+			if (peeks < 20) peeks = 20;
+
+			double scan = nanosPerPeek(plain, distinct, peeks, checksum);
+			double hash = nanosPerPeek(counting, distinct, peeks * 100, checksum);
+			printf("%10d %10d %14.1f %14.1f %9.0fx\n", size, distinct, scan, hash, scan / hash);
+		}
+	}
+
+	// print the checksum so the peeks can't be optimized away
+	fprintf(stderr, "checksum %lld\n", checksum);
+	return 0;
+}
@@ -0,0 +1,77 @@
+// Compares MagicBag::peek and peekMany (SSE2/AVX2 kernels) against the plain
+// scalar counting loop peek() used to have, on large int and float bags.
+//
+// Build: g++ -O2 -std=c++11 bench_simd.cpp -o bench_simd
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "MagicBag.h"
+
+using namespace std;
+
+// the loop peek() used before it had SIMD kernels; noinline keeps the
+// comparison honest by stopping the compiler from specializing it per call
+template<class T> __attribute__((noinline)) int scalarPeek(const T* contents, int size, T item)
+{
+	int count = 0;
+	for (int i = 0; i < size; i++)
+	{
+		if (contents[i] == item) count++;
+	}
+	return count;
+}
+
+template<class F> double millisPerCall(F f, int reps)
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for (int r = 0; r < reps; r++) f(r);
+	chrono::steady_clock::time_point end = chrono::steady_clock::now();
+	return chrono::duration<double, milli>(end - start).count() / reps;
+}
+
+template<class T> void run(const char* typeName, int size, long long& checksum)
+{
+	MagicBag<T> bag(size, 1);
+	vector<T> plain(size);
+	for (int i = 0; i < size; i++)
+	{
+		bag.insert((T)(i % 1000));
+		plain[i] = (T)(i % 1000);
+	}
+
+	const int reps = 20;
+	T values[PEEK_GROUP];
+	for (int j = 0; j < PEEK_GROUP; j++) values[j] = (T)j;
+	int counts[PEEK_GROUP];
+
+	double scalar = millisPerCall([&](int r) { checksum += scalarPeek(plain.data(), size, (T)r); }, reps);
+	double simd = millisPerCall([&](int r) { checksum += bag.peek((T)r); }, reps);
+	double scalarMany = millisPerCall([&](int) {
+		for (int j = 0; j < PEEK_GROUP; j++) checksum += scalarPeek(plain.data(), size, values[j]);
+	}, reps);
+	double simdMany = millisPerCall([&](int) {
+		bag.peekMany(values, PEEK_GROUP, counts);
+		checksum += counts[0];
+	}, reps);
+
+	printf("%-6s %10d  peek: scalar %7.2f ms  simd %7.2f ms  (%.1fx)\n", typeName, size, scalar, simd, scalar / simd);
+	printf("%-6s %10d  %d values: scalar %7.2f ms  peekMany %7.2f ms  (%.1fx)\n",
+	       typeName, size, PEEK_GROUP, scalarMany, simdMany, scalarMany / simdMany);
+}
+
+int main() {
+
+	long long checksum = 0;
+#ifdef MAGICBAG_X86_SIMD
+	printf("AVX2 %s\n", cpuHasAvx2() ? "available" : "not available (using SSE2)");
+#endif
+	run<int>("int", 10000000, checksum);
+	run<float>("float", 10000000, checksum);
+	run<int>("int", 100000, checksum);
+
+	// print the checksum so the peeks can't be optimized away
+	fprintf(stderr, "checksum %lld\n", checksum);
+	return 0;
+}
@@ -1,11 +1,11 @@
 #include <iostream>
 
 #include "MagicBag.h"
+#include "ReservoirMagicBag.h"
+#include "WeightedMagicBag.h"
 
 using namespace std;
 
-void memoryLeakTest();
-
 int main() {
 
 	MagicBag<int> mb1;
@@ -33,10 +33,6 @@ int main() {
 	cout << mb1 << endl;
 	cout << mb2 << endl << endl;
 
-//	for (int i = 0; i < 1000000; i++) {
-		memoryLeakTest();
-//	}
-
 	// Testing the ability to add an "unlimited" number of items
 	MagicBag<int> mb3;
 	for (int i = 0; i < 50; i++) {
@@ -48,12 +44,32 @@ int main() {
 	cout << mb3 << endl << endl;
 
 	mb2.print(cerr);
+	cerr << endl << endl;
+
+	// Weighted items come out in proportion to their weight
+	IndexedWeightedMagicBag<string> prizes;
+	prizes.insert("common", 10);
+	prizes.insert("rare", 3);
+	prizes.insert("legendary", 1);
+	cout << prizes << endl;
+	cout << "A " << prizes.sample() << " prize was sampled." << endl;
+
+	prizes.freeze();
+	cout << "A " << prizes.sample() << " prize was sampled from the frozen bag." << endl;
+	prizes.thaw();
+
+	prizes.remove("legendary");
+	cout << "A " << prizes.draw() << " prize was drawn." << endl;
+	cout << prizes << endl << endl;
+
+	// A reservoir bag keeps a fixed-size uniform sample of everything inserted
+	ReservoirMagicBag<int> sample(5);
+	for (int i = 0; i < 1000000; i++) {
+		sample.insert(i);
+	}
+	cout << sample << " out of " << sample.streamSize() << " items" << endl;
+	cout << "A " << sample.draw() << " was drawn from the sample." << endl;
 
-	system("pause");
 	return 0;
 }
 
-
-void memoryLeakTest() {
-	MagicBag<int> mb;
-}